@@ -0,0 +1,119 @@
+// Speed of the two trellis passes in forced_align.h on synthetic emissions.
+//
+//   align-bench [--frames 15000] [--classes 32] [--targets 3000] [--noise 1] [--min-seconds 1]
+//
+// Builds log-softmaxed emissions in which each target peaks once in its share of the frames, over
+// blank-dominated rows with Gaussian logit noise (raise --noise to make the text fit the audio
+// worse), then times forced_align() and ctc_posteriors() with one shared TrellisWorkspace and
+// reports both, their ratio and the workspace size. Also runs the 30 s window sizes of a real job.
+
+#include "forced_align.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// T x C log-probs: class 0 is blank, 1 .. C-2 letters, C-1 the star column.
+std::vector<float> synthetic_emissions(int64_t T, int64_t C, const std::vector<int64_t>& targets, double noise) {
+  std::mt19937 rng(7);
+  std::normal_distribution<float> dist(0.0f, float(noise));
+  const int64_t L = int64_t(targets.size());
+  std::vector<float> lp(size_t(T * C));
+  for (int64_t t = 0; t < T; ++t) {
+    float* row = lp.data() + size_t(t * C);
+    for (int64_t c = 0; c < C - 1; ++c) row[c] = dist(rng);
+    row[0] += 2.0f;
+    if ((t * L) % T < L) row[targets[size_t(t * L / T)]] += 6.0f;  // first frame of each target's share
+    const float m = *std::max_element(row, row + C - 1);
+    double sum = 0.0;
+    for (int64_t c = 0; c < C - 1; ++c) sum += std::exp(double(row[c] - m));
+    const float log_sum = m + float(std::log(sum));
+    for (int64_t c = 0; c < C - 1; ++c) row[c] -= log_sum;
+    row[C - 1] = -5.0f;
+  }
+  return lp;
+}
+
+template <typename F>
+double seconds_per_call(F&& f, double min_seconds) {
+  using clock = std::chrono::steady_clock;
+  int iters = 0;
+  double elapsed = 0.0;
+  const auto t0 = clock::now();
+  do {
+    f();
+    ++iters;
+    elapsed = std::chrono::duration<double>(clock::now() - t0).count();
+  } while (elapsed < min_seconds);
+  return elapsed / iters;
+}
+
+void run(int64_t T, int64_t C, int64_t L, double noise, double min_seconds) {
+  std::mt19937 rng(1);
+  std::vector<int64_t> targets(static_cast<size_t>(L));
+  for (auto& k : targets) k = 1 + int64_t(rng() % uint32_t(C - 2));
+  const std::vector<float> lp = synthetic_emissions(T, C, targets, noise);
+
+  TrellisWorkspace ws;
+  std::vector<int64_t> path;
+  std::vector<float> scores;
+  TokenPosteriors post;
+  const double viterbi = seconds_per_call(
+      [&] { forced_align(lp.data(), T, C, targets.data(), L, 0, path, scores, &ws); }, min_seconds);
+  const double posteriors = seconds_per_call(
+      [&] { ctc_posteriors(lp.data(), T, C, targets.data(), L, 0, post, &ws); }, min_seconds);
+  std::printf("T=%-6lld C=%-3lld L=%-5lld  viterbi %9.2f ms  posteriors %9.2f ms  (%.1fx)  workspace %7.1f MB"
+              "  log-likelihood %.1f\n",
+              (long long)T, (long long)C, (long long)L, viterbi * 1e3, posteriors * 1e3, posteriors / viterbi,
+              ws.bytes() / 1e6, post.log_likelihood);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int64_t frames = 15000;
+  int64_t classes = 32;
+  int64_t num_targets = 3000;
+  double noise = 1.0;
+  double min_seconds = 1.0;
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) throw std::runtime_error("Missing value for " + a);
+      return argv[++i];
+    };
+    if (a == "--frames") {
+      frames = std::atoll(value().c_str());
+    } else if (a == "--classes") {
+      classes = std::atoll(value().c_str());
+    } else if (a == "--targets") {
+      num_targets = std::atoll(value().c_str());
+    } else if (a == "--noise") {
+      noise = std::atof(value().c_str());
+    } else if (a == "--min-seconds") {
+      min_seconds = std::atof(value().c_str());
+    } else {
+      std::fprintf(stderr, "Unknown argument: %s\n", a.c_str());
+      return 2;
+    }
+  }
+  if (classes < 3 || num_targets < 1 || frames < 2 * num_targets) {  // room for repeated targets
+    std::fprintf(stderr, "Need --classes >= 3, --targets >= 1 and --frames >= 2 x --targets\n");
+    return 2;
+  }
+
+  run(frames, classes, num_targets, noise, min_seconds);
+  // One 30 s window (1500 frames) with a short and a dense transcript.
+  run(1500, classes, 100, noise, min_seconds);
+  run(1500, classes, 400, noise, min_seconds);
+  return 0;
+}
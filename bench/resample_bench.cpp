@@ -0,0 +1,188 @@
+// Speed and accuracy of the 16 kHz conversion paths in decode_audio_to_16k_mono.
+//
+//   resample-bench [--seconds 600] [--threads 1] [--min-seconds 1] [audio files...]
+//
+// Writes synthetic 44.1 kHz and 48 kHz stereo WAVs (in-band tones at 440/2500/6000 Hz, and
+// out-of-band tones at 9/12/15 kHz that must not alias into the output), decodes each with the
+// linear and the polyphase resampler and reports decode speed (x realtime) plus, for the tone
+// files, SNR against the exact 16 kHz signal after the best delay compensation (in-band) or the
+// level of whatever aliased through (out-of-band). Extra audio files are timed only.
+
+#include "audio_decode.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kInBand[] = {440.0, 2500.0, 6000.0};
+constexpr double kOutOfBand[] = {9000.0, 12000.0, 15000.0};
+constexpr double kAmplitude = 0.25;
+
+double tones(const double* freqs, size_t n, double t) {
+  double x = 0.0;
+  for (size_t i = 0; i < n; ++i) x += kAmplitude * std::sin(2.0 * kPi * freqs[i] * t);
+  return x;
+}
+
+void put_u16(std::ofstream& f, uint16_t v) {
+  const char b[2] = {char(v & 0xFF), char(v >> 8)};
+  f.write(b, 2);
+}
+
+void put_u32(std::ofstream& f, uint32_t v) {
+  put_u16(f, uint16_t(v & 0xFFFF));
+  put_u16(f, uint16_t(v >> 16));
+}
+
+// 16-bit stereo WAV of the given tones, the same signal on both channels.
+void write_tone_wav(const std::filesystem::path& path, uint32_t rate, double seconds, const double* freqs, size_t n) {
+  std::ofstream f(path, std::ios::binary);
+  if (!f) throw std::runtime_error("Failed to write " + path.string());
+  const uint32_t frames = uint32_t(rate * seconds);
+  const uint32_t data_bytes = frames * 4;
+  f.write("RIFF", 4);
+  put_u32(f, 36 + data_bytes);
+  f.write("WAVEfmt ", 8);
+  put_u32(f, 16);
+  put_u16(f, 1);
+  put_u16(f, 2);
+  put_u32(f, rate);
+  put_u32(f, rate * 4);
+  put_u16(f, 4);
+  put_u16(f, 16);
+  f.write("data", 4);
+  put_u32(f, data_bytes);
+  std::vector<char> block;
+  block.reserve(size_t(rate) * 4);
+  for (uint32_t i = 0; i < frames; ++i) {
+    const auto s = uint16_t(int16_t(std::lround(32767.0 * tones(freqs, n, double(i) / rate))));
+    for (int ch = 0; ch < 2; ++ch) {
+      block.push_back(char(s & 0xFF));
+      block.push_back(char(s >> 8));
+    }
+    if (block.size() >= size_t(rate) * 4) {
+      f.write(block.data(), std::streamsize(block.size()));
+      block.clear();
+    }
+  }
+  f.write(block.data(), std::streamsize(block.size()));
+}
+
+// Best SNR (dB) of `y` against the in-band tones delayed by -2..2 output samples, and that delay.
+void passband_snr(const std::vector<float>& y, double& snr_db, double& lag_ms) {
+  snr_db = -1e9;
+  lag_ms = 0.0;
+  const size_t margin = 1600;  // skip the stream edges
+  if (y.size() <= 2 * margin) return;
+  for (int step = -40; step <= 40; ++step) {
+    const double lag = step * 0.05;
+    double err = 0.0;
+    double power = 0.0;
+    for (size_t k = margin; k + margin < y.size(); k += 7) {
+      const double ref = tones(kInBand, 3, (double(k) - lag) / 16000.0);
+      err += (y[k] - ref) * (y[k] - ref);
+      power += ref * ref;
+    }
+    const double snr = 10.0 * std::log10(power / std::max(err, 1e-30));
+    if (snr > snr_db) {
+      snr_db = snr;
+      lag_ms = lag / 16.0;
+    }
+  }
+}
+
+// Output level (dB relative to the input tones) of what aliased through.
+double alias_level(const std::vector<float>& y) {
+  double power = 0.0;
+  for (float v : y) power += double(v) * v;
+  const double input_power = 3 * kAmplitude * kAmplitude / 2;
+  return 10.0 * std::log10(std::max(power / std::max<size_t>(1, y.size()), 1e-30) / input_power);
+}
+
+double decode_seconds(const std::filesystem::path& path, int threads, Resampler resampler, double min_seconds,
+                      std::vector<float>& out) {
+  using clock = std::chrono::steady_clock;
+  int iters = 0;
+  double elapsed = 0.0;
+  const auto t0 = clock::now();
+  do {
+    out = decode_audio_to_16k_mono(path, threads, resampler);
+    ++iters;
+    elapsed = std::chrono::duration<double>(clock::now() - t0).count();
+  } while (elapsed < min_seconds);
+  return elapsed / iters;
+}
+
+enum class Signal { InBand, OutOfBand, File };
+
+void run(const std::filesystem::path& path, const char* label, Signal signal, int threads, double min_seconds) {
+  for (Resampler resampler : {Resampler::Linear, Resampler::Polyphase}) {
+    std::vector<float> y;
+    const double t = decode_seconds(path, threads, resampler, min_seconds, y);
+    const double audio_seconds = y.size() / 16000.0;
+    std::printf("%-24s %-9s %8.1fx realtime", label, resampler == Resampler::Linear ? "linear" : "polyphase",
+                audio_seconds / t);
+    if (signal == Signal::InBand) {
+      double snr = 0.0;
+      double lag_ms = 0.0;
+      passband_snr(y, snr, lag_ms);
+      std::printf("  passband SNR %6.1f dB (delay %+.3f ms)", snr, lag_ms);
+    } else if (signal == Signal::OutOfBand) {
+      std::printf("  aliasing %7.1f dB", alias_level(y));
+    }
+    std::printf("\n");
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  double seconds = 600.0;
+  int threads = 1;
+  double min_seconds = 1.0;
+  std::vector<std::filesystem::path> files;
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) throw std::runtime_error("Missing value for " + a);
+      return argv[++i];
+    };
+    if (a == "--seconds") {
+      seconds = std::atof(value().c_str());
+    } else if (a == "--threads") {
+      threads = std::atoi(value().c_str());
+    } else if (a == "--min-seconds") {
+      min_seconds = std::atof(value().c_str());
+    } else if (!a.empty() && a[0] == '-') {
+      std::fprintf(stderr, "Unknown argument: %s\n", a.c_str());
+      return 2;
+    } else {
+      files.emplace_back(a);
+    }
+  }
+
+  const auto dir = std::filesystem::temp_directory_path();
+  for (uint32_t rate : {44100u, 48000u}) {
+    const auto in_band = dir / ("resample_bench_" + std::to_string(rate) + "_inband.wav");
+    const auto out_of_band = dir / ("resample_bench_" + std::to_string(rate) + "_alias.wav");
+    write_tone_wav(in_band, rate, seconds, kInBand, 3);
+    write_tone_wav(out_of_band, rate, seconds, kOutOfBand, 3);
+    const std::string khz = std::to_string(rate / 1000) + "." + std::to_string(rate / 100 % 10) + "k";
+    run(in_band, (khz + " stereo in-band").c_str(), Signal::InBand, threads, min_seconds);
+    run(out_of_band, (khz + " stereo 9-15 kHz").c_str(), Signal::OutOfBand, threads, min_seconds);
+    std::filesystem::remove(in_band);
+    std::filesystem::remove(out_of_band);
+  }
+  for (const auto& path : files) run(path, path.filename().string().c_str(), Signal::File, threads, min_seconds);
+  return 0;
+}
@@ -0,0 +1,115 @@
+// Throughput benchmark for kana::romanize_kana.
+//
+//   romanize-bench [--srt test/samples/japanese_test.srt] [--pinyin-table data/Chinese_to_Pinyin.txt]
+//                  [--synthetic-mb 64] [--min-seconds 1]
+//
+// Romanizes the SRT text and a synthetic Japanese corpus (kana-heavy mix with
+// yoon, kanji, punctuation and ASCII) repeatedly and reports MB/s of input.
+
+#include "kana_romaji.h"
+#include "kanji_pinyin.h"
+#include "srt_io.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string encode(uint32_t cp) {
+  std::string s;
+  s.push_back(char(0xE0 | (cp >> 12)));
+  s.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+  s.push_back(char(0x80 | (cp & 0x3F)));
+  return s;
+}
+
+// Roughly the character mix of Japanese subtitles: mostly hiragana, some katakana
+// (often with small ya/yu/yo), some kanji, punctuation and the odd ASCII word.
+std::string synthetic_corpus(size_t bytes) {
+  std::mt19937 rng(12345);
+  const std::vector<std::string> yoon = {encode(0x3083), encode(0x3085), encode(0x3087)};
+  const std::vector<std::string> punct = {encode(0x3001), encode(0x3002), encode(0x30FC), " ", "!"};
+  std::string out;
+  out.reserve(bytes + 16);
+  while (out.size() < bytes) {
+    const unsigned k = rng() % 100;
+    if (k < 55) {
+      out += encode(0x3041 + rng() % 0x53);  // hiragana
+    } else if (k < 62) {
+      out += encode(0x304D + 2 * (rng() % 8));  // ki, gi, ... followed by a small ya/yu/yo
+      out += yoon[rng() % yoon.size()];
+    } else if (k < 77) {
+      out += encode(0x30A1 + rng() % 0x56);  // katakana
+    } else if (k < 90) {
+      out += encode(0x4E00 + rng() % 0x5000);  // kanji
+    } else if (k < 98) {
+      out += punct[rng() % punct.size()];
+    } else {
+      out += "ok";
+    }
+  }
+  return out;
+}
+
+void run(const char* name, const std::string& text, double min_seconds) {
+  using clock = std::chrono::steady_clock;
+  size_t out_bytes = 0;
+  int64_t iters = 0;
+  const auto t0 = clock::now();
+  double elapsed = 0.0;
+  do {
+    out_bytes += kana::romanize_kana(text).size();
+    ++iters;
+    elapsed = std::chrono::duration<double>(clock::now() - t0).count();
+  } while (elapsed < min_seconds);
+  const double mb = double(text.size()) * double(iters) / (1024.0 * 1024.0);
+  std::printf("%-10s %10zu bytes x %6lld iters  %8.1f MB/s  (%zu bytes out/iter)\n", name, text.size(),
+              static_cast<long long>(iters), mb / elapsed, out_bytes / size_t(iters));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string srt_path = "test/samples/japanese_test.srt";
+  std::string pinyin_path = "data/Chinese_to_Pinyin.txt";
+  double synthetic_mb = 64.0;
+  double min_seconds = 1.0;
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) throw std::runtime_error("Missing value for " + a);
+      return argv[++i];
+    };
+    if (a == "--srt") {
+      srt_path = value();
+    } else if (a == "--pinyin-table") {
+      pinyin_path = value();
+    } else if (a == "--synthetic-mb") {
+      synthetic_mb = std::atof(value().c_str());
+    } else if (a == "--min-seconds") {
+      min_seconds = std::atof(value().c_str());
+    } else {
+      std::fprintf(stderr, "Unknown argument: %s\n", a.c_str());
+      return 2;
+    }
+  }
+
+  if (!kanji::load_pinyin_table(pinyin_path)) {
+    std::fprintf(stderr, "warning: pinyin table not loaded (%s); kanji are copied through\n", pinyin_path.c_str());
+  }
+
+  std::string srt_text;
+  for (const auto& seg : read_srt_utf8(srt_path)) {
+    srt_text += seg.text;
+    srt_text.push_back(' ');
+  }
+  run("srt", srt_text, min_seconds);
+  if (synthetic_mb > 0) run("synthetic", synthetic_corpus(size_t(synthetic_mb * 1024 * 1024)), min_seconds);
+  return 0;
+}
@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+"""Align one file with --resampler linear and --resampler polyphase and compare the timestamps."""
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+from compare_srt_timestamps import compare_srts, parse_srt
+
+
+def align(aligner, audio, srt, model, resampler, output, extra):
+    cmd = [aligner, '--audio', audio, '--srt', srt, '--model', model,
+           '--output', output, '--resampler', resampler] + extra
+    subprocess.run(cmd, check=True)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--aligner', default='./cpp-ort-aligner', help='Path to the cpp-ort-aligner binary')
+    parser.add_argument('--audio', required=True, help='Audio file (44.1/48 kHz to exercise the resamplers)')
+    parser.add_argument('--srt', required=True, help='Input SRT file')
+    parser.add_argument('--model', required=True, help='Model directory')
+    parser.add_argument('--tolerance', type=int, default=20, help='Tolerance in ms (default: 20)')
+    parser.add_argument('extra', nargs=argparse.REMAINDER, help='Further aligner flags (after --)')
+    args = parser.parse_args()
+    extra = args.extra[1:] if args.extra[:1] == ['--'] else args.extra
+
+    with tempfile.TemporaryDirectory() as tmp:
+        linear = os.path.join(tmp, 'linear.srt')
+        polyphase = os.path.join(tmp, 'polyphase.srt')
+        align(args.aligner, args.audio, args.srt, args.model, 'linear', linear, extra)
+        align(args.aligner, args.audio, args.srt, args.model, 'polyphase', polyphase, extra)
+
+        diffs = [abs(a - b) * 1000
+                 for r, t in zip(parse_srt(linear), parse_srt(polyphase))
+                 for a, b in ((r[1], t[1]), (r[2], t[2]))]
+        if diffs:
+            print(f"Boundary shift: mean={sum(diffs) / len(diffs):.1f}ms, max={max(diffs):.0f}ms, "
+                  f"unchanged={sum(d == 0 for d in diffs)}/{len(diffs)}")
+        passed, msg = compare_srts(linear, polyphase, args.tolerance)
+    print(msg)
+    sys.exit(0 if passed else 1)
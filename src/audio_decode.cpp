@@ -1,47 +1,780 @@
 #define MINIAUDIO_IMPLEMENTATION
 #include "miniaudio.h"
 #include "audio_decode.h"
+#include "mmap_file.h"
+#include "resample.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <numeric>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <cmath>
 
-std::vector<float> decode_audio_to_16k_mono(const std::filesystem::path& audio_path) {
-    ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 1, 16000);
-    ma_decoder decoder;
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AUDIO_DECODE_SSE2 1
+#else
+#define AUDIO_DECODE_SSE2 0
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define AUDIO_DECODE_NEON 1
+#else
+#define AUDIO_DECODE_NEON 0
+#endif
+
+namespace {
+
+constexpr size_t kChunkFrames = 16000;  // 1 second at 16kHz
+
+// Parallel decoding: ranges shorter than this are not worth a decoder of their own.
+constexpr uint64_t kMinRangeFrames = 16000 * 60;
+// Output frames decoded ahead of each range start and discarded, so the resampler's filter
+// state has settled by the time the range begins.
+constexpr uint64_t kRangeWarmupFrames = 4000;
+
+// 16kHz mono PCM16 or float32 samples that need no decoding, inside the input bytes: the data
+// chunk of a WAV file, the array of a .npy file, or a whole raw PCM input.
+struct WavPcm {
+    const char* data = nullptr;
+    size_t frames = 0;
+    bool is_float = false;
+};
+
+uint16_t read_u16le(const char* p) {
+    const auto* b = reinterpret_cast<const unsigned char*>(p);
+    return uint16_t(b[0] | (b[1] << 8));
+}
+
+uint32_t read_u32le(const char* p) {
+    const auto* b = reinterpret_cast<const unsigned char*>(p);
+    return uint32_t(b[0]) | (uint32_t(b[1]) << 8) | (uint32_t(b[2]) << 16) | (uint32_t(b[3]) << 24);
+}
+
+bool host_is_little_endian() {
+    const uint16_t one = 1;
+    unsigned char first;
+    std::memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+// True if the file is a plain RIFF/WAVE whose samples need no decoding at all: 16kHz mono
+// PCM16 or float32 (also as WAVE_FORMAT_EXTENSIBLE) with a complete data chunk. Everything
+// else (other rates or layouts, compressed formats, RF64, truncated or streamed files) goes
+// through miniaudio.
+bool find_16k_mono_pcm(const char* p, size_t size, WavPcm& out) {
+    if (!p || size < 12 || !host_is_little_endian()) return false;
+    if (std::memcmp(p, "RIFF", 4) != 0 || std::memcmp(p + 8, "WAVE", 4) != 0) return false;
+
+    bool have_fmt = false;
+    uint16_t format = 0;
+    uint16_t channels = 0;
+    uint32_t rate = 0;
+    uint16_t block_align = 0;
+    uint16_t bits = 0;
+    size_t pos = 12;
+    while (pos + 8 <= size) {
+        const char* chunk = p + pos;
+        const size_t chunk_size = read_u32le(chunk + 4);
+        const size_t body = pos + 8;
+        if (std::memcmp(chunk, "fmt ", 4) == 0) {
+            if (chunk_size < 16 || body + 16 > size) return false;
+            format = read_u16le(p + body);
+            channels = read_u16le(p + body + 2);
+            rate = read_u32le(p + body + 4);
+            block_align = read_u16le(p + body + 12);
+            bits = read_u16le(p + body + 14);
+            if (format == 0xFFFE) {
+                // WAVE_FORMAT_EXTENSIBLE: the format tag leads the subformat GUID
+                if (chunk_size < 40 || body + 40 > size) return false;
+                format = read_u16le(p + body + 24);
+            }
+            have_fmt = true;
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            if (!have_fmt || channels != 1 || rate != 16000) return false;
+            if (format == 1 && bits == 16 && block_align == 2) {
+                out.is_float = false;
+            } else if (format == 3 && bits == 32 && block_align == 4) {
+                out.is_float = true;
+            } else {
+                return false;
+            }
+            if (chunk_size > size - body) return false;
+            out.data = p + body;
+            out.frames = chunk_size / block_align;
+            return true;
+        }
+        pos = body + chunk_size + (chunk_size & 1);  // chunks are word aligned
+    }
+    return false;
+}
+
+// Same scaling as miniaudio (x / 32768, exact in float), 8 samples per step where available.
+void s16_to_f32(const char* src, float* dst, size_t n) {
+    constexpr float kScale = 1.0f / 32768.0f;
+    size_t i = 0;
+#if AUDIO_DECODE_SSE2
+    const __m128 scale = _mm_set1_ps(kScale);
+    for (; i + 8 <= n; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#elif AUDIO_DECODE_NEON
+    for (; i + 8 <= n; i += 8) {
+        int16_t block[8];
+        std::memcpy(block, src + 2 * i, sizeof(block));
+        const int16x8_t v = vld1q_s16(block);
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), kScale));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), kScale));
+    }
+#endif
+    for (; i < n; ++i) {
+        int16_t x;
+        std::memcpy(&x, src + 2 * i, sizeof(x));
+        dst[i] = float(x) * kScale;
+    }
+}
+
+void copy_wav_samples(const WavPcm& wav, size_t first, size_t count, float* dst) {
+    if (wav.is_float) {
+        std::memcpy(dst, wav.data + first * sizeof(float), count * sizeof(float));
+    } else {
+        s16_to_f32(wav.data + first * sizeof(int16_t), dst, count);
+    }
+}
+
+// .npy file (format 1.0-3.0) holding a float32 or int16 array with at most one dimension
+// longer than 1. Returns false if the bytes are not .npy at all; throws for .npy contents it
+// cannot use as audio.
+bool find_npy_pcm(const char* p, size_t size, WavPcm& out) {
+    if (!p || size < 10 || std::memcmp(p, "\x93NUMPY", 6) != 0) return false;
+    if (!host_is_little_endian()) throw std::runtime_error(".npy audio input needs a little-endian host");
+
+    const unsigned major = static_cast<unsigned char>(p[6]);
+    size_t header_begin = 10;
+    size_t header_len = 0;
+    if (major == 1) {
+        header_len = read_u16le(p + 8);
+    } else if ((major == 2 || major == 3) && size >= 12) {
+        header_begin = 12;
+        header_len = read_u32le(p + 8);
+    } else {
+        throw std::runtime_error("Unsupported .npy version " + std::to_string(major));
+    }
+    if (header_len > size - header_begin) throw std::runtime_error("Truncated .npy header");
+
+    // The header is a Python dict literal: {'descr': '<f4', 'fortran_order': False, 'shape': (n,), }
+    const std::string_view header(p + header_begin, header_len);
+    auto value_of = [&](std::string_view key) -> std::string_view {
+        const size_t k = header.find(key);
+        if (k == std::string_view::npos) return {};
+        const size_t v = header.find_first_not_of(": ", k + key.size());
+        return v == std::string_view::npos ? std::string_view() : header.substr(v);
+    };
+    const std::string_view descr = value_of("'descr'");
+    bool is_float = false;
+    if (descr.substr(0, 5) == "'<f4'") {
+        is_float = true;
+    } else if (descr.substr(0, 5) != "'<i2'") {
+        throw std::runtime_error("Unsupported .npy audio dtype " + std::string(descr.substr(0, descr.find(','))) +
+                                 " (expected float32 '<f4' or int16 '<i2')");
+    }
+
+    const std::string_view shape = value_of("'shape'");
+    const size_t close = shape.find(')');
+    if (shape.empty() || shape[0] != '(' || close == std::string_view::npos) {
+        throw std::runtime_error("Malformed .npy header: " + std::string(header));
+    }
+    uint64_t count = 1;
+    int dims = 0;
+    int long_dims = 0;
+    for (size_t pos = 1; pos < close;) {
+        size_t end = shape.find(',', pos);
+        if (end == std::string_view::npos || end > close) end = close;
+        const std::string_view dim = shape.substr(pos, end - pos);
+        const size_t digits = dim.find_first_not_of(' ');
+        if (digits != std::string_view::npos) {
+            const uint64_t n = std::stoull(std::string(dim.substr(digits)));
+            count *= n;
+            ++dims;
+            if (n != 1) ++long_dims;
+        }
+        pos = end + 1;
+    }
+    if (dims == 0 || long_dims > 1) {
+        throw std::runtime_error("Unsupported .npy audio shape " + std::string(shape.substr(0, close + 1)) +
+                                 " (expected a 1-D array of 16kHz samples)");
+    }
+
+    const size_t data = header_begin + header_len;
+    const size_t width = is_float ? sizeof(float) : sizeof(int16_t);
+    if (count > (size - data) / width) throw std::runtime_error("Truncated .npy data");
+    out.data = p + data;
+    out.frames = static_cast<size_t>(count);
+    out.is_float = is_float;
+    return true;
+}
+
+// The whole input as headerless 16kHz mono PCM; a trailing partial sample is ignored.
+WavPcm raw_pcm(const char* p, size_t size, PcmFormat format) {
+    if (!host_is_little_endian()) throw std::runtime_error("Raw PCM audio input needs a little-endian host");
+    WavPcm out;
+    out.data = p;
+    out.is_float = format == PcmFormat::F32LE;
+    out.frames = size / (out.is_float ? sizeof(float) : sizeof(int16_t));
+    return out;
+}
 
-    ma_result result = ma_decoder_init_file(audio_path.string().c_str(), &config, &decoder);
+// Samples the input holds as they are: all of it for raw PCM, else a 16kHz mono WAV data
+// chunk or a .npy array.
+bool find_direct_pcm(std::string_view bytes, const AudioInput& input, WavPcm& out) {
+    if (input.raw) {
+        out = raw_pcm(bytes.data(), bytes.size(), input.pcm_format);
+        return true;
+    }
+    return find_16k_mono_pcm(bytes.data(), bytes.size(), out) || find_npy_pcm(bytes.data(), bytes.size(), out);
+}
+
+std::vector<float> pcm_samples(const WavPcm& pcm) {
+    std::vector<float> samples(pcm.frames);
+    copy_wav_samples(pcm, 0, pcm.frames, samples.data());
+    return samples;
+}
+
+// Formats recognized on stdin by their first bytes; anything else there is raw PCM. Bare MPEG
+// frame sync is not among them: raw PCM starting with a -1 sample would match it.
+bool has_container_signature(std::string_view bytes) {
+    for (std::string_view magic : {"RIFF", "RF64", "fLaC", "OggS", "ID3", "\x93NUMPY"}) {
+        if (bytes.substr(0, magic.size()) == magic) return true;
+    }
+    return false;
+}
+
+// All of stdin, in binary mode.
+std::vector<char> read_stdin() {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    std::vector<char> bytes(size_t(1) << 20);
+    size_t filled = 0;
+    for (;;) {
+        if (filled == bytes.size()) bytes.resize(bytes.size() * 2);
+        const size_t n = std::fread(bytes.data() + filled, 1, bytes.size() - filled, stdin);
+        filled += n;
+        if (n == 0) break;
+    }
+    if (std::ferror(stdin)) throw std::runtime_error("Failed to read audio from stdin");
+    bytes.resize(filled);
+    return bytes;
+}
+
+MappedFile map_audio_file(const std::filesystem::path& audio_path) {
+    try {
+        return MappedFile(audio_path);
+    } catch (const std::exception& e) {
+        throw std::runtime_error("Failed to open audio file: " + audio_path.string() + " (" + e.what() + ")");
+    }
+}
+
+// Decoder reading from the file bytes, converting to float with `channels` channels at
+// `rate` (0: keep the file's own), by default 16kHz mono.
+void init_decoder(std::string_view bytes, const std::filesystem::path& audio_path, ma_decoder& decoder,
+                  ma_uint32 channels = 1, ma_uint32 rate = 16000) {
+    ma_decoder_config config = ma_decoder_config_init(ma_format_f32, channels, rate);
+    ma_result result = ma_decoder_init_memory(bytes.data(), bytes.size(), &config, &decoder);
     if (result != MA_SUCCESS) {
         throw std::runtime_error("Failed to open audio file: " + audio_path.string() +
                                  " (error: " + std::to_string(result) + ")");
     }
+}
+
+// Decodes up to `max_frames` frames from the decoder's position. The first `expected`
+// frames (the reported length, if any) are decoded straight into the result; anything
+// beyond that goes through a one-second scratch chunk.
+std::vector<float> read_frames(ma_decoder& decoder, uint64_t max_frames, uint64_t expected) {
+    std::vector<float> samples(static_cast<size_t>(std::min(max_frames, expected)));
+    std::vector<float> chunk;
+    size_t filled = 0;
+    while (filled < max_frames) {
+        float* dst = nullptr;
+        ma_uint64 want = 0;
+        if (filled < samples.size()) {
+            dst = samples.data() + filled;
+            want = samples.size() - filled;
+        } else {
+            chunk.resize(kChunkFrames);
+            dst = chunk.data();
+            want = std::min<uint64_t>(kChunkFrames, max_frames - filled);
+        }
+        ma_uint64 frames_read = 0;
+        ma_result result = ma_decoder_read_pcm_frames(&decoder, dst, want, &frames_read);
+        if (frames_read == 0) break;
+
+        if (dst == chunk.data()) samples.insert(samples.end(), chunk.begin(), chunk.begin() + frames_read);
+        filled += static_cast<size_t>(frames_read);
+
+        if (result != MA_SUCCESS) break;
+    }
+    samples.resize(filled);
+    return samples;
+}
+
+// WAV and FLAC seek sample-accurately without scanning the file; other containers (MP3,
+// Vorbis) seek by decoding from the start or not at all.
+bool has_cheap_seek(std::string_view bytes) {
+    const char* p = bytes.data();
+    if (bytes.size() >= 12 && std::memcmp(p, "RIFF", 4) == 0 && std::memcmp(p + 8, "WAVE", 4) == 0) return true;
+    return bytes.size() >= 4 && std::memcmp(p, "fLaC", 4) == 0;
+}
+
+// Decodes output frames [begin, begin + count) of the file with a decoder of its own into
+// dst, starting `warmup` frames early. With `tail`, frames past the range (up to the end of
+// the stream) are appended there. Returns false on a short read.
+bool decode_range(std::string_view bytes, const std::filesystem::path& audio_path, uint64_t begin, uint64_t count,
+                  uint64_t warmup, float* dst, std::vector<float>* tail) {
+    ma_decoder decoder;
+    init_decoder(bytes, audio_path, decoder);
+    bool ok = ma_decoder_seek_to_pcm_frame(&decoder, begin - warmup) == MA_SUCCESS;
+    if (ok && warmup > 0) {
+        std::vector<float> discard = read_frames(decoder, warmup, warmup);
+        ok = discard.size() == warmup;
+    }
+    uint64_t filled = 0;
+    while (ok && filled < count) {
+        ma_uint64 frames_read = 0;
+        ma_result result = ma_decoder_read_pcm_frames(&decoder, dst + filled, count - filled, &frames_read);
+        filled += frames_read;
+        if (frames_read == 0 || result != MA_SUCCESS) break;
+    }
+    ok = ok && filled == count;
+    if (ok && tail) *tail = read_frames(decoder, std::numeric_limits<uint64_t>::max(), 0);
+    ma_decoder_uninit(&decoder);
+    return ok;
+}
+
+// Splits a seekable stream of `total` output frames into up to `threads` ranges decoded
+// concurrently into disjoint slices of `out`. Range starts sit on multiples of the resampler
+// period (16000 / gcd(rates) output frames), where a freshly seeked decoder is in the same
+// phase as a serial one, and each range decodes a short warm-up first, so the result matches
+// serial decoding to within float rounding of the filter state. Returns false if the input
+// is not worth splitting or a range failed; the caller then decodes serially.
+bool decode_parallel(std::string_view bytes, const std::filesystem::path& audio_path, ma_decoder& probe,
+                     uint64_t total, int threads, std::vector<float>& out) {
+    if (threads <= 0) threads = static_cast<int>(std::thread::hardware_concurrency());
+    const uint64_t ranges = std::min<uint64_t>(uint64_t(std::max(1, threads)), total / kMinRangeFrames);
+    if (ranges < 2 || !has_cheap_seek(bytes)) return false;
+
+    ma_uint32 input_rate = 0;
+    if (ma_data_source_get_data_format(probe.pBackend, nullptr, nullptr, &input_rate, nullptr, 0) != MA_SUCCESS ||
+        input_rate == 0) {
+        return false;
+    }
+    const uint64_t period = 16000 / std::gcd<uint64_t>(input_rate, 16000);
+    const uint64_t warmup = input_rate == 16000 ? 0 : (kRangeWarmupFrames + period - 1) / period * period;
+
+    std::vector<uint64_t> bounds(ranges + 1);
+    for (uint64_t r = 0; r < ranges; ++r) bounds[r] = total * r / ranges / period * period;
+    bounds[ranges] = total;
+
+    out.resize(static_cast<size_t>(total));
+    std::vector<float> tail;
+    std::atomic<bool> ok{true};
+    auto work = [&](uint64_t r) {
+        try {
+            const uint64_t begin = bounds[r];
+            const bool last = r + 1 == ranges;
+            if (!decode_range(bytes, audio_path, begin, bounds[r + 1] - begin, std::min(warmup, begin),
+                              out.data() + begin, last ? &tail : nullptr)) {
+                ok = false;
+            }
+        } catch (const std::exception&) {
+            ok = false;
+        }
+    };
+    std::vector<std::thread> pool;
+    pool.reserve(size_t(ranges - 1));
+    for (uint64_t r = 1; r < ranges; ++r) pool.emplace_back(work, r);
+    work(0);
+    for (auto& t : pool) t.join();
+    if (!ok) {
+        out.clear();
+        return false;
+    }
+
+    out.insert(out.end(), tail.begin(), tail.end());
+    return true;
+}
+
+// Decoder at the file's own rate and channel count, for the polyphase path. Returns false
+// (with the decoder already uninitialized) if the file is 16kHz or the rate ratio is not
+// supported; the linear path then handles it.
+bool init_native_decoder(std::string_view bytes, const std::filesystem::path& audio_path, ma_decoder& decoder) {
+    init_decoder(bytes, audio_path, decoder, 0, 0);
+    if (decoder.outputSampleRate == 16000 || !PolyphaseResampler::supported(decoder.outputSampleRate, 16000)) {
+        ma_decoder_uninit(&decoder);
+        return false;
+    }
+    return true;
+}
+
+// Input side of the polyphase path: native-rate frames decoded on demand and downmixed to
+// mono. Buffers input frames [offset, offset + frames.size()); `total` is the stream length
+// once a read has hit the end.
+struct PolyphaseInput {
+    ma_decoder* decoder = nullptr;
+    std::vector<float> frames;
+    int64_t offset = 0;
+    bool at_end = false;
+    uint64_t total = std::numeric_limits<uint64_t>::max();
+    std::vector<float> interleaved;
+
+    // Restarts the buffer at input frame `first` (clamped to the start of the stream).
+    ma_result seek(int64_t first) {
+        offset = std::max<int64_t>(first, 0);
+        frames.clear();
+        at_end = false;
+        return ma_decoder_seek_to_pcm_frame(decoder, static_cast<ma_uint64>(offset));
+    }
+
+    // Decodes until the buffer reaches input frame `last` or the stream ends.
+    void fill(int64_t last) {
+        const ma_uint32 channels = decoder->outputChannels;
+        while (!at_end && offset + static_cast<int64_t>(frames.size()) < last) {
+            interleaved.resize(kChunkFrames * channels);
+            ma_uint64 frames_read = 0;
+            ma_result result = ma_decoder_read_pcm_frames(decoder, interleaved.data(), kChunkFrames, &frames_read);
+            const size_t filled = frames.size();
+            frames.resize(filled + static_cast<size_t>(frames_read));
+            downmix_to_mono(interleaved.data(), static_cast<size_t>(frames_read), channels, frames.data() + filled);
+            if (frames_read == 0 || result != MA_SUCCESS) {
+                at_end = true;
+                total = static_cast<uint64_t>(offset) + frames.size();
+            }
+        }
+    }
+
+    // Drops buffered frames before input frame `first`.
+    void discard_before(int64_t first) {
+        if (first <= offset) return;
+        const int64_t n = std::min<int64_t>(first - offset, static_cast<int64_t>(frames.size()));
+        frames.erase(frames.begin(), frames.begin() + n);
+        offset += n;
+    }
+};
+
+// Resamples output frames [begin, end) from `in`, whose buffer must start at or before the
+// first input frame they read, one chunk at a time into `dst(count)`. Stops early at the end
+// of the stream; returns the number of frames written.
+template <typename Dst>
+uint64_t resample_frames(const PolyphaseResampler& rs, PolyphaseInput& in, uint64_t begin, uint64_t end, Dst&& dst) {
+    uint64_t n = begin;
+    while (n < end) {
+        uint64_t count = std::min<uint64_t>(kChunkFrames, end - n);
+        int64_t first = 0;
+        int64_t last = 0;
+        rs.input_window(n, n + count, first, last);
+        in.fill(last);
+        if (in.at_end) {
+            const uint64_t available = rs.output_frames(in.total);
+            if (n >= available) break;
+            count = std::min(count, available - n);
+        }
+        rs.process(in.frames.data(), in.offset, in.frames.size(), in.total, n, static_cast<size_t>(count),
+                   dst(static_cast<size_t>(count)));
+        n += count;
+        rs.input_window(n, n + 1, first, last);
+        in.discard_before(first);
+    }
+    return n - begin;
+}
+
+// Polyphase counterpart of decode_parallel over `total` output frames. The filter keeps no
+// state, so ranges start anywhere without a warm-up: each decodes just the input window its
+// outputs read, and the result is identical to serial resampling.
+bool decode_parallel_polyphase(std::string_view bytes, const std::filesystem::path& audio_path,
+                               const PolyphaseResampler& rs, uint64_t total, int threads, std::vector<float>& out) {
+    if (threads <= 0) threads = static_cast<int>(std::thread::hardware_concurrency());
+    const uint64_t ranges = std::min<uint64_t>(uint64_t(std::max(1, threads)), total / kMinRangeFrames);
+    if (ranges < 2 || !has_cheap_seek(bytes)) return false;
+
+    std::vector<uint64_t> bounds(ranges + 1);
+    for (uint64_t r = 0; r <= ranges; ++r) bounds[r] = total * r / ranges;
+
+    // The last range runs to the end of the stream, whatever its length turns out to be.
+    out.resize(static_cast<size_t>(bounds[ranges - 1]));
+    std::vector<float> tail;
+    std::atomic<bool> ok{true};
+    auto work = [&](uint64_t r) {
+        ma_decoder decoder;
+        try {
+            init_decoder(bytes, audio_path, decoder, 0, 0);
+        } catch (const std::exception&) {
+            ok = false;
+            return;
+        }
+        try {
+            PolyphaseInput in;
+            in.decoder = &decoder;
+            int64_t first = 0;
+            int64_t last = 0;
+            rs.input_window(bounds[r], bounds[r] + 1, first, last);
+            if (in.seek(first) != MA_SUCCESS) {
+                ok = false;
+            } else if (r + 1 < ranges) {
+                float* dst = out.data() + bounds[r];
+                const uint64_t n = resample_frames(rs, in, bounds[r], bounds[r + 1], [&](size_t count) {
+                    float* p = dst;
+                    dst += count;
+                    return p;
+                });
+                if (n != bounds[r + 1] - bounds[r]) ok = false;
+            } else {
+                resample_frames(rs, in, bounds[r], std::numeric_limits<uint64_t>::max(), [&](size_t count) {
+                    tail.resize(tail.size() + count);
+                    return tail.data() + tail.size() - count;
+                });
+            }
+        } catch (const std::exception&) {
+            ok = false;
+        }
+        ma_decoder_uninit(&decoder);
+    };
+    std::vector<std::thread> pool;
+    pool.reserve(size_t(ranges - 1));
+    for (uint64_t r = 1; r < ranges; ++r) pool.emplace_back(work, r);
+    work(0);
+    for (auto& t : pool) t.join();
+    if (!ok) {
+        out.clear();
+        return false;
+    }
+
+    out.insert(out.end(), tail.begin(), tail.end());
+    return true;
+}
+
+// Decodes the whole file through the polyphase path from a native-rate decoder at frame 0.
+std::vector<float> decode_polyphase(std::string_view bytes, const std::filesystem::path& audio_path,
+                                    ma_decoder& decoder, int threads) {
+    const PolyphaseResampler rs(decoder.outputSampleRate, 16000);
+    ma_uint64 total_in = 0;
+    if (ma_decoder_get_length_in_pcm_frames(&decoder, &total_in) != MA_SUCCESS) total_in = 0;
+
+    std::vector<float> samples;
+    if (total_in > 0 && decode_parallel_polyphase(bytes, audio_path, rs, rs.output_frames(total_in), threads, samples)) {
+        return samples;
+    }
+    samples.reserve(static_cast<size_t>(rs.output_frames(total_in)));
+    PolyphaseInput in;
+    in.decoder = &decoder;
+    resample_frames(rs, in, 0, std::numeric_limits<uint64_t>::max(), [&](size_t count) {
+        samples.resize(samples.size() + count);
+        return samples.data() + samples.size() - count;
+    });
+    return samples;
+}
+
+// Whether decode_bytes() would split the container into concurrent ranges rather than run one
+// decoder through it: a WAV or FLAC of known length spanning at least two ranges.
+bool splits_into_ranges(std::string_view bytes, const std::filesystem::path& audio_path, int threads) {
+    if (threads <= 0) threads = static_cast<int>(std::thread::hardware_concurrency());
+    if (threads < 2 || !has_cheap_seek(bytes)) return false;
+    ma_decoder decoder;
+    init_decoder(bytes, audio_path, decoder);
+    ma_uint64 total_frames = 0;
+    const bool known = ma_decoder_get_length_in_pcm_frames(&decoder, &total_frames) == MA_SUCCESS;
+    ma_decoder_uninit(&decoder);
+    return known && total_frames / kMinRangeFrames >= 2;
+}
+
+// Decodes a container held in memory to 16kHz mono. `audio_path` names it in errors.
+std::vector<float> decode_bytes(std::string_view bytes, const std::filesystem::path& audio_path, int threads,
+                                Resampler resampler) {
+    ma_decoder decoder;
+    if (resampler == Resampler::Polyphase && init_native_decoder(bytes, audio_path, decoder)) {
+        std::vector<float> samples = decode_polyphase(bytes, audio_path, decoder, threads);
+        ma_decoder_uninit(&decoder);
+        return samples;
+    }
+    init_decoder(bytes, audio_path, decoder);
 
     // Get total frame count
     ma_uint64 total_frames;
-    result = ma_decoder_get_length_in_pcm_frames(&decoder, &total_frames);
+    ma_result result = ma_decoder_get_length_in_pcm_frames(&decoder, &total_frames);
     if (result != MA_SUCCESS) {
         // If we can't get length, decode in chunks
         total_frames = 0;
     }
 
     std::vector<float> samples;
-    if (total_frames > 0) {
-        samples.reserve(static_cast<size_t>(total_frames));
+    if (total_frames == 0 || !decode_parallel(bytes, audio_path, decoder, total_frames, threads, samples)) {
+        samples = read_frames(decoder, std::numeric_limits<uint64_t>::max(), total_frames);
     }
+    ma_decoder_uninit(&decoder);
+    return samples;
+}
 
-    // Decode in chunks
-    const size_t chunk_size = 16000;  // 1 second at 16kHz
-    std::vector<float> chunk(chunk_size);
+}  // namespace
 
-    while (true) {
-        ma_uint64 frames_read;
-        result = ma_decoder_read_pcm_frames(&decoder, chunk.data(), chunk_size, &frames_read);
-        if (frames_read == 0) break;
+AudioSamples::AudioSamples(std::vector<float> samples)
+    : owned_(std::move(samples)), data_(owned_.data()), size_(owned_.size()) {}
 
-        samples.insert(samples.end(), chunk.begin(), chunk.begin() + frames_read);
+AudioSamples::AudioSamples(std::shared_ptr<const MappedFile> mapping, const float* data, size_t count)
+    : mapping_(std::move(mapping)), data_(data), size_(count) {}
 
-        if (result != MA_SUCCESS) break;
+namespace {
+
+// Samples of PCM found by find_direct_pcm() in `file`.
+AudioSamples direct_samples(std::shared_ptr<const MappedFile> file, const WavPcm& pcm) {
+    // float32 samples are used where they lie in the mapping
+    if (pcm.is_float && reinterpret_cast<uintptr_t>(pcm.data) % alignof(float) == 0) {
+        return AudioSamples(std::move(file), reinterpret_cast<const float*>(pcm.data), pcm.frames);
     }
+    return AudioSamples(pcm_samples(pcm));
+}
 
-    ma_decoder_uninit(&decoder);
+}  // namespace
+
+AudioSamples load_audio_16k_mono(const std::filesystem::path& audio_path, const AudioInput& input) {
+    WavPcm pcm;
+    if (audio_path.string() == "-") {
+        const std::vector<char> data = read_stdin();
+        const std::string_view bytes(data.data(), data.size());
+        AudioInput stdin_input = input;
+        stdin_input.raw = input.raw || !has_container_signature(bytes);
+        if (find_direct_pcm(bytes, stdin_input, pcm)) return AudioSamples(pcm_samples(pcm));
+        return AudioSamples(decode_bytes(bytes, "<stdin>", input.threads, input.resampler));
+    }
+
+    auto file = std::make_shared<const MappedFile>(map_audio_file(audio_path));
+    const std::string_view bytes(file->data(), file->size());
+    if (find_direct_pcm(bytes, input, pcm)) return direct_samples(std::move(file), pcm);
+    return AudioSamples(decode_bytes(bytes, audio_path, input.threads, input.resampler));
+}
+
+bool load_audio_without_serial_decode(const std::filesystem::path& audio_path, const AudioInput& input,
+                                      AudioSamples& out) {
+    auto file = std::make_shared<const MappedFile>(map_audio_file(audio_path));
+    const std::string_view bytes(file->data(), file->size());
+    WavPcm pcm;
+    if (find_direct_pcm(bytes, input, pcm)) {
+        out = direct_samples(std::move(file), pcm);
+        return true;
+    }
+    if (!splits_into_ranges(bytes, audio_path, input.threads)) return false;
+    out = AudioSamples(decode_bytes(bytes, audio_path, input.threads, input.resampler));
+    return true;
+}
+
+std::vector<float> decode_audio_to_16k_mono(const std::filesystem::path& audio_path, int threads, Resampler resampler) {
+    const MappedFile file = map_audio_file(audio_path);
+    const std::string_view bytes(file.data(), file.size());
+
+    // Already 16kHz mono PCM: no decoder, no resampler
+    WavPcm pcm;
+    if (find_direct_pcm(bytes, AudioInput{}, pcm)) return pcm_samples(pcm);
+    return decode_bytes(bytes, audio_path, threads, resampler);
+}
+
+struct AudioReader::Impl {
+    MappedFile file;
+    WavPcm wav;  // set when the input bypasses the decoder
+    bool use_decoder = false;
+    ma_decoder decoder;
+    int64_t cursor = 0;
+    // Polyphase path: the decoder runs at the file's own rate and feeds `input`.
+    std::unique_ptr<PolyphaseResampler> resampler;
+    PolyphaseInput input;
+};
+
+AudioReader::AudioReader(const std::filesystem::path& audio_path, const AudioInput& input) : impl_(new Impl) {
+    if (audio_path.string() == "-") {
+        throw std::runtime_error("Audio from stdin cannot be read by time range; pass a file instead");
+    }
+    impl_->file = map_audio_file(audio_path);
+    const std::string_view bytes(impl_->file.data(), impl_->file.size());
+    if (find_direct_pcm(bytes, input, impl_->wav)) {
+        length_ = static_cast<int64_t>(impl_->wav.frames);
+        return;
+    }
+
+    if (input.resampler == Resampler::Polyphase && init_native_decoder(bytes, audio_path, impl_->decoder)) {
+        impl_->resampler = std::make_unique<PolyphaseResampler>(impl_->decoder.outputSampleRate, 16000);
+        impl_->input.decoder = &impl_->decoder;
+    } else {
+        init_decoder(bytes, audio_path, impl_->decoder);
+    }
+    impl_->use_decoder = true;
+
+    ma_uint64 total_frames;
+    if (ma_decoder_get_length_in_pcm_frames(&impl_->decoder, &total_frames) == MA_SUCCESS && total_frames > 0) {
+        length_ = static_cast<int64_t>(impl_->resampler ? impl_->resampler->output_frames(total_frames) : total_frames);
+    }
+}
+
+AudioReader::~AudioReader() {
+    if (impl_->use_decoder) ma_decoder_uninit(&impl_->decoder);
+}
+
+std::vector<float> AudioReader::read(int64_t start, int64_t count) {
+    std::vector<float> samples;
+    if (count <= 0) return samples;
+    if (start < 0) start = 0;
+
+    if (!impl_->use_decoder) {
+        const int64_t available = std::max<int64_t>(0, std::min(count, length_ - start));
+        samples.resize(static_cast<size_t>(available));
+        copy_wav_samples(impl_->wav, static_cast<size_t>(start), samples.size(), samples.data());
+        return samples;
+    }
+
+    if (impl_->resampler) {
+        if (start != impl_->cursor) {
+            int64_t first = 0;
+            int64_t last = 0;
+            impl_->resampler->input_window(static_cast<uint64_t>(start), static_cast<uint64_t>(start) + 1, first, last);
+            ma_result result = impl_->input.seek(first);
+            if (result != MA_SUCCESS) {
+                throw std::runtime_error("Failed to seek audio to sample " + std::to_string(start) +
+                                         " (error: " + std::to_string(result) + ")");
+            }
+            impl_->cursor = start;
+        }
+        samples.reserve(static_cast<size_t>(length_ >= 0 ? std::max<int64_t>(0, std::min(count, length_ - start)) : 0));
+        resample_frames(*impl_->resampler, impl_->input, static_cast<uint64_t>(start),
+                        static_cast<uint64_t>(start + count), [&](size_t n) {
+                            samples.resize(samples.size() + n);
+                            return samples.data() + samples.size() - n;
+                        });
+        impl_->cursor += static_cast<int64_t>(samples.size());
+        return samples;
+    }
+
+    if (start != impl_->cursor) {
+        ma_result result = ma_decoder_seek_to_pcm_frame(&impl_->decoder, static_cast<ma_uint64>(start));
+        if (result != MA_SUCCESS) {
+            throw std::runtime_error("Failed to seek audio to sample " + std::to_string(start) +
+                                     " (error: " + std::to_string(result) + ")");
+        }
+        impl_->cursor = start;
+    }
+
+    const uint64_t expected = length_ > 0 ? static_cast<uint64_t>(std::max<int64_t>(0, length_ - start)) : 0;
+    samples = read_frames(impl_->decoder, static_cast<uint64_t>(count), expected);
+    impl_->cursor += static_cast<int64_t>(samples.size());
     return samples;
 }
@@ -1,10 +1,95 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
 #include <vector>
 #include <cstdint>
 
-// Decode any supported audio file (MP3, WAV, FLAC, etc.) to 16kHz mono float samples
+class MappedFile;
+
+// Sample-rate conversion for inputs that are not already 16kHz.
+enum class Resampler {
+    Linear,     // miniaudio's linear resampler
+    Polyphase,  // downmix, then a 128-tap windowed-sinc polyphase filter (resample.h); falls
+                // back to Linear for rate ratios it does not support
+};
+
+// Sample formats of headerless 16kHz mono PCM (--pcm-format).
+enum class PcmFormat { S16LE, F32LE };
+
+// How to read --audio.
+struct AudioInput {
+    int threads = 0;  // decode threads, <= 0: hardware concurrency
+    Resampler resampler = Resampler::Linear;
+    bool raw = false;  // headerless PCM in `pcm_format` rather than a container
+    PcmFormat pcm_format = PcmFormat::S16LE;
+};
+
+// 16kHz mono waveform, either decoded into memory or used in place from a memory-mapped file.
+class AudioSamples {
+public:
+    AudioSamples() = default;
+    explicit AudioSamples(std::vector<float> samples);
+    // `count` floats at `data` inside `mapping`, which is kept alive with the samples.
+    AudioSamples(std::shared_ptr<const MappedFile> mapping, const float* data, size_t count);
+    AudioSamples(AudioSamples&&) = default;
+    AudioSamples& operator=(AudioSamples&&) = default;
+    AudioSamples(const AudioSamples&) = delete;
+    AudioSamples& operator=(const AudioSamples&) = delete;
+
+    const float* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool mapped() const { return mapping_ != nullptr; }
+
+private:
+    std::vector<float> owned_;
+    std::shared_ptr<const MappedFile> mapping_;
+    const float* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Reads --audio as 16kHz mono. '-' reads stdin: raw PCM if input.raw, otherwise WAV, FLAC,
+// Ogg, MP3 with an ID3 tag or .npy by signature, and raw PCM in input.pcm_format failing that. Files are
+// mapped; float32 data that needs no conversion (raw f32 PCM, float32 .npy, 16kHz mono float
+// WAV) is used in place without a copy. .npy files hold a 1-D float32 or int16 array at 16kHz.
+// Throws on read or decode failure.
+AudioSamples load_audio_16k_mono(const std::filesystem::path& audio_path, const AudioInput& input);
+
+// load_audio_16k_mono() for a file, but only when that needs no serial decode: PCM that is read
+// straight from the mapping, or a WAV/FLAC long enough to decode as time ranges on several
+// threads. Returns false otherwise (MP3, Vorbis, short files, a single decode thread), leaving
+// `out` alone; such input is better streamed through AudioReader so decoding overlaps inference.
+bool load_audio_without_serial_decode(const std::filesystem::path& audio_path, const AudioInput& input,
+                                      AudioSamples& out);
+
+// Decode any supported audio file (MP3, WAV, FLAC, .npy, etc.) to 16kHz mono float samples
 // Returns samples in range [-1.0, 1.0]
+// Long WAV/FLAC inputs are decoded as time ranges on up to `threads` threads (<= 0: hardware
+// concurrency); other formats, and any range that fails, fall back to serial decoding.
 // Throws on decode failure
-std::vector<float> decode_audio_to_16k_mono(const std::filesystem::path& audio_path);
+std::vector<float> decode_audio_to_16k_mono(const std::filesystem::path& audio_path, int threads = 0,
+                                            Resampler resampler = Resampler::Linear);
+
+// Random-access 16kHz mono decoding without loading the whole file.
+// Consecutive reads continue from the decoder's position; other starts seek.
+// Raw PCM and .npy inputs are read straight from the mapping; stdin is not supported.
+class AudioReader {
+public:
+    explicit AudioReader(const std::filesystem::path& audio_path, const AudioInput& input = {});
+    ~AudioReader();
+    AudioReader(const AudioReader&) = delete;
+    AudioReader& operator=(const AudioReader&) = delete;
+
+    // Total length in 16kHz samples, or -1 if the decoder cannot report it
+    int64_t length_samples() const { return length_; }
+
+    // Decode up to `count` samples starting at sample `start` (fewer at end of stream)
+    // Throws on seek failure
+    std::vector<float> read(int64_t start, int64_t count);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+    int64_t length_ = -1;
+};
@@ -0,0 +1,510 @@
+#include "batch_align.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "forced_align.h"
+#include "postprocess.h"
+#include "span_align.h"
+#include "utf8_utils.h"
+
+namespace {
+
+// Preprocessing of the whole transcript, done once per file.
+//
+// The normalized segment texts are copied once into `text`; every later stage works on
+// views into it. preprocess_text() works chunk by chunk (words, or characters for CJK), and
+// segments are joined with a single space, so the chunks of any run of segments are exactly
+// their own chunks with the chunks of " " in between (none in word mode, one in character
+// mode). Each chunk k owns text_starred[2k] ("<star>") and [2k + 1], and the targets
+// [token_offsets[2k], token_offsets[2k + 2]).
+struct TokenPlan {
+  std::vector<char> text;              // not a std::string: moving one may move SSO bytes under the views
+  std::vector<size_t> seg_text_begin;  // per segment, plus end
+  std::vector<std::string_view> text_starred;
+  std::vector<int64_t> targets;
+  std::vector<size_t> token_offsets{0};  // per text_starred entry, plus end
+  std::vector<int64_t> repeats;          // repeats[i]: #p in [1, i] with targets[p] == targets[p - 1]
+  std::vector<size_t> seg_chunk_begin;
+  std::vector<size_t> seg_chunk_end;
+
+  std::string_view seg_text(size_t i) const {
+    return std::string_view(text.data() + seg_text_begin[i], seg_text_begin[i + 1] - seg_text_begin[i]);
+  }
+  size_t target_begin(size_t chunk) const { return token_offsets[2 * chunk]; }
+
+  // Targets of segments [a, b): first target index and count; repeat count R.
+  void range(size_t a, size_t b, size_t& first, int64_t& L, int64_t& R) const {
+    first = target_begin(seg_chunk_begin[a]);
+    const size_t last = target_begin(seg_chunk_end[b - 1]);
+    L = int64_t(last - first);
+    R = L > 1 ? repeats[last - 1] - repeats[first] : 0;
+  }
+};
+
+// Copies the segment texts into plan.text, trimmed and with newlines turned into spaces.
+void load_segment_texts(TokenPlan& plan, const std::vector<SrtSegment>& segs) {
+  size_t bytes = 0;
+  for (const auto& seg : segs) bytes += seg.text.size();
+  plan.text.resize(bytes);
+  plan.seg_text_begin.resize(segs.size() + 1);
+  size_t pos = 0;
+  for (size_t i = 0; i < segs.size(); ++i) {
+    plan.seg_text_begin[i] = pos;
+    const std::string& t = segs[i].text;
+    size_t l = 0;
+    size_t r = t.size();
+    while (l < r && std::isspace(static_cast<unsigned char>(t[l]))) ++l;
+    while (r > l && std::isspace(static_cast<unsigned char>(t[r - 1]))) --r;
+    for (size_t k = l; k < r; ++k) plan.text[pos++] = t[k] == '\n' ? ' ' : t[k];
+  }
+  plan.seg_text_begin[segs.size()] = pos;
+  plan.text.resize(pos);
+}
+
+// Calls fn(i) for every i in [0, n) on up to `threads` threads (<= 0: hardware concurrency),
+// handing out indices in blocks of `grain`. The first exception is rethrown once all workers
+// have stopped.
+template <typename Fn>
+void parallel_for(size_t n, int threads, size_t grain, Fn&& fn) {
+  if (threads <= 0) threads = static_cast<int>(std::thread::hardware_concurrency());
+  const size_t blocks = (n + grain - 1) / grain;
+  const size_t workers = std::min(blocks, size_t(std::max(1, threads)));
+  if (workers <= 1) {
+    for (size_t i = 0; i < n; ++i) fn(i);
+    return;
+  }
+  std::atomic<size_t> next{0};
+  std::exception_ptr error;
+  std::atomic<bool> failed{false};
+  auto worker = [&] {
+    for (size_t b = next++; b < blocks && !failed; b = next++) {
+      try {
+        const size_t end = std::min(n, (b + 1) * grain);
+        for (size_t i = b * grain; i < end; ++i) fn(i);
+      } catch (...) {
+        if (!failed.exchange(true)) error = std::current_exception();
+      }
+    }
+  };
+  std::vector<std::thread> pool;
+  pool.reserve(workers - 1);
+  for (size_t w = 1; w < workers; ++w) pool.emplace_back(worker);
+  worker();
+  for (auto& t : pool) t.join();
+  if (error) std::rethrow_exception(error);
+}
+
+// Segments handed to a preprocessing worker at a time.
+constexpr size_t kPreprocessGrain = 32;
+
+// Appends the chunks of `src` to `dst` (a TokenPlan or PreprocessResult); token_offsets keeps
+// its single trailing entry.
+template <typename Dst>
+void append_chunks(Dst& dst, const PreprocessResult& src) {
+  const size_t base = dst.targets.size();
+  if (!dst.token_offsets.empty()) dst.token_offsets.pop_back();
+  dst.text_starred.insert(dst.text_starred.end(), src.text_starred.begin(), src.text_starred.end());
+  for (size_t offset : src.token_offsets) dst.token_offsets.push_back(base + offset);
+  dst.targets.insert(dst.targets.end(), src.targets.begin(), src.targets.end());
+}
+
+// Blocks of segments are preprocessed independently on up to `threads` threads, each into one
+// reused result, then concatenated in segment order, so the plan does not depend on the
+// thread count.
+TokenPlan build_token_plan(const std::vector<SrtSegment>& segs, const Vocab& vocab, PreprocessConfig config,
+                           int threads) {
+  config.token_strings = false;  // ids are all alignment needs
+  TokenPlan plan;
+  load_segment_texts(plan, segs);
+  plan.seg_chunk_begin.resize(segs.size());
+  plan.seg_chunk_end.resize(segs.size());
+
+  // Chunk indices are block-local until the blocks are concatenated.
+  const auto separator = preprocess_text(" ", vocab, config);
+  const size_t blocks = (segs.size() + kPreprocessGrain - 1) / kPreprocessGrain;
+  std::vector<PreprocessResult> per_block(blocks);
+  parallel_for(blocks, threads, /*grain=*/1, [&](size_t b) {
+    PreprocessResult& prep = per_block[b];
+    const size_t end = std::min(segs.size(), (b + 1) * kPreprocessGrain);
+    for (size_t i = b * kPreprocessGrain; i < end; ++i) {
+      if (i) append_chunks(prep, separator);
+      plan.seg_chunk_begin[i] = prep.text_starred.size() / 2;
+      preprocess_text(plan.seg_text(i), vocab, config, prep);
+      plan.seg_chunk_end[i] = prep.text_starred.size() / 2;
+    }
+  });
+
+  size_t num_entries = 0;
+  size_t num_targets = 0;
+  for (const auto& prep : per_block) {
+    num_entries += prep.text_starred.size();
+    num_targets += prep.targets.size();
+  }
+  plan.text_starred.reserve(num_entries);
+  plan.token_offsets.reserve(num_entries + 1);
+  plan.targets.reserve(num_targets);
+  for (size_t b = 0; b < blocks; ++b) {
+    const size_t chunk_base = plan.text_starred.size() / 2;
+    const size_t end = std::min(segs.size(), (b + 1) * kPreprocessGrain);
+    for (size_t i = b * kPreprocessGrain; i < end; ++i) {
+      plan.seg_chunk_begin[i] += chunk_base;
+      plan.seg_chunk_end[i] += chunk_base;
+    }
+    append_chunks(plan, per_block[b]);
+    per_block[b] = PreprocessResult();
+  }
+
+  plan.repeats.assign(plan.targets.size(), 0);
+  for (size_t i = 1; i < plan.targets.size(); ++i) {
+    plan.repeats[i] = plan.repeats[i - 1] + (plan.targets[i] == plan.targets[i - 1] ? 1 : 0);
+  }
+  return plan;
+}
+
+// Buffers of one alignment job (trellis, path, spans, timestamps), reused by later jobs.
+struct AlignWorkspace {
+  TrellisWorkspace trellis;
+  SpanWorkspace span;
+  std::vector<int64_t> path;
+  std::vector<float> scores;
+  TokenPosteriors post;
+  std::vector<float> chunk_confidence;
+  std::vector<TokenSpan> spans;
+  std::vector<WordTimestamp> word_ts;
+  std::vector<float> token_probs;
+  size_t accounted_bytes = 0;  // bytes() when last returned to the pool
+
+  size_t bytes() const {
+    return trellis.bytes() + span.bytes() + path.capacity() * sizeof(int64_t) +
+           (scores.capacity() + post.occupancy.capacity() + post.peak.capacity() +
+            post.expected_start.capacity() + post.expected_end.capacity() + chunk_confidence.capacity() +
+            token_probs.capacity()) * sizeof(float) +
+           spans.capacity() * sizeof(TokenSpan) + word_ts.capacity() * sizeof(WordTimestamp);
+  }
+};
+
+// Process-wide free list of workspaces. A job leases one for its duration, so there are never
+// more workspaces than concurrently running jobs, and their buffers survive across
+// align_segments() calls (long-form sections, later files). A workspace that grew past
+// kRetainBytes (one very long job) is dropped on return rather than pinned for the rest of
+// the process. Sizes are sampled when a workspace is returned.
+class WorkspacePool {
+ public:
+  std::unique_ptr<AlignWorkspace> acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.jobs;
+    if (free_.empty()) {
+      ++stats_.workspaces;
+      return std::make_unique<AlignWorkspace>();
+    }
+    std::unique_ptr<AlignWorkspace> ws = std::move(free_.back());
+    free_.pop_back();
+    stats_.retained_bytes -= ws->accounted_bytes;
+    return ws;
+  }
+
+  void release(std::unique_ptr<AlignWorkspace> ws) {
+    const size_t bytes = ws->bytes();
+    std::lock_guard<std::mutex> lock(mutex_);
+    total_bytes_ += bytes - ws->accounted_bytes;
+    ws->accounted_bytes = bytes;
+    stats_.peak_bytes = std::max(stats_.peak_bytes, bytes);
+    stats_.peak_total_bytes = std::max(stats_.peak_total_bytes, total_bytes_);
+    if (bytes > kRetainBytes) {
+      total_bytes_ -= bytes;
+      return;
+    }
+    stats_.retained_bytes += bytes;
+    free_.push_back(std::move(ws));
+  }
+
+  AlignWorkspaceStats stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+ private:
+  static constexpr size_t kRetainBytes = size_t(256) << 20;
+
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<AlignWorkspace>> free_;
+  AlignWorkspaceStats stats_;
+  size_t total_bytes_ = 0;  // over all live workspaces, leased or free
+};
+
+WorkspacePool& workspace_pool() {
+  static WorkspacePool pool;
+  return pool;
+}
+
+// Workspace leased from the pool for one scope.
+class WorkspaceLease {
+ public:
+  WorkspaceLease() : ws_(workspace_pool().acquire()) {}
+  ~WorkspaceLease() { workspace_pool().release(std::move(ws_)); }
+  WorkspaceLease(const WorkspaceLease&) = delete;
+  WorkspaceLease& operator=(const WorkspaceLease&) = delete;
+
+  AlignWorkspace& operator*() { return *ws_; }
+
+ private:
+  std::unique_ptr<AlignWorkspace> ws_;
+};
+
+// One range of segments aligned against one slice of frames.
+struct AlignJob {
+  size_t seg_begin = 0;
+  size_t seg_end = 0;
+  int64_t frame_off = 0;
+  int64_t frame_cnt = 0;
+  std::string debug;  // deferred debug log line (jobs run concurrently)
+};
+
+struct AlignContext {
+  const TokenPlan& plan;
+  const float* log_probs;
+  int64_t classes;
+  int stride_ms;
+  const Vocab& vocab;
+  bool posterior_confidence;
+  int64_t blank_id;
+  float log_vocab;
+};
+
+// Split [a, b) until T >= L + R holds for every range; same split points as the former
+// recursive sub-batching, which also only looked at the original timestamps.
+void plan_jobs(const std::vector<SrtSegment>& segs, const TokenPlan& plan, size_t a, size_t b, int64_t frame_off,
+               int64_t frame_cnt, int stride_ms, Logger& log, int depth, std::vector<AlignJob>& jobs) {
+  if (a >= b || frame_cnt <= 0) return;
+
+  const int64_t T = frame_cnt;
+  size_t first = 0;
+  int64_t L = 0;
+  int64_t R = 0;
+  plan.range(a, b, first, L, R);
+
+  if (T < L + R) {
+    // Need to split — can't fit all targets in available frames
+    if (b - a <= 1 || frame_cnt < 2) {
+      // Can't split further — skip alignment, keep original timestamps
+      log.info("[sub-batch] Cannot split further for CTC, skipping alignment");
+      return;
+    }
+
+    const size_t mid = (b - a) / 2;
+
+    // Determine frame split point from segment timestamps
+    const double t_end_first = segs[a + mid - 1].end_sec;
+    const double t_start_second = segs[a + mid].start_sec;
+    const double split_time = (t_end_first + t_start_second) / 2.0;
+    int64_t split_frame = static_cast<int64_t>(split_time * 1000.0 / stride_ms) - frame_off;
+    split_frame = std::max<int64_t>(1, std::min<int64_t>(split_frame, frame_cnt - 1));
+
+    {
+      std::ostringstream ss;
+      ss << "[sub-batch depth=" << depth << "] Splitting " << (b - a)
+         << " segments (T=" << T << " < L+R=" << (L + R)
+         << ") at seg " << mid << ", frame " << split_frame;
+      log.info(ss.str());
+    }
+
+    plan_jobs(segs, plan, a, a + mid, frame_off, split_frame, stride_ms, log, depth + 1, jobs);
+    plan_jobs(segs, plan, a + mid, b, frame_off + split_frame, frame_cnt - split_frame, stride_ms, log, depth + 1,
+              jobs);
+    return;
+  }
+
+  AlignJob job;
+  job.seg_begin = a;
+  job.seg_end = b;
+  job.frame_off = frame_off;
+  job.frame_cnt = frame_cnt;
+  jobs.push_back(std::move(job));
+}
+
+void run_job(std::vector<SrtSegment>& segs, const AlignContext& ctx, AlignJob& job, AlignWorkspace& ws) {
+  const TokenPlan& plan = ctx.plan;
+  const int64_t classes = ctx.classes;
+  const int stride_ms = ctx.stride_ms;
+
+  // Slice of the token plan covering this job's segments
+  const size_t chunk_begin = plan.seg_chunk_begin[job.seg_begin];
+  const size_t chunk_end = plan.seg_chunk_end[job.seg_end - 1];
+  const std::string_view* text_starred = plan.text_starred.data() + 2 * chunk_begin;
+  const size_t num_entries = 2 * (chunk_end - chunk_begin);
+  const size_t target_first = plan.target_begin(chunk_begin);
+  const int64_t* targets = plan.targets.data() + target_first;
+  const int64_t T = job.frame_cnt;
+  const int64_t L = int64_t(plan.target_begin(chunk_end) - target_first);
+
+  // 5. Run forced alignment on the emission slice
+  const float* slice_ptr = ctx.log_probs + job.frame_off * classes;
+  std::vector<int64_t>& path = ws.path;
+  std::vector<float>& scores = ws.scores;
+  forced_align(slice_ptr, T, classes, targets, L, /*blank=*/0, path, scores, &ws.trellis);
+
+  // 5b. Optional forward-backward pass: chunk confidence = mean peak posterior of its targets.
+  std::vector<float>& chunk_confidence = ws.chunk_confidence;
+  if (ctx.posterior_confidence) {
+    TokenPosteriors& post = ws.post;
+    ctc_posteriors(slice_ptr, T, classes, targets, L, /*blank=*/0, post, &ws.trellis);
+    {
+      std::ostringstream ss;
+      ss << "[posterior] log-likelihood=" << post.log_likelihood << " (" << (post.log_likelihood / double(T))
+         << " per frame) over T=" << T << " L=" << L;
+      job.debug = ss.str();
+    }
+    chunk_confidence.assign(num_entries, -1.0f);
+    for (size_t i = 0; i < num_entries; ++i) {
+      const size_t k0 = plan.token_offsets[2 * chunk_begin + i] - target_first;
+      const size_t k1 = plan.token_offsets[2 * chunk_begin + i + 1] - target_first;
+      if (k1 == k0) continue;
+      float sum = 0.0f;
+      for (size_t k = k0; k < k1; ++k) sum += post.peak[k];
+      chunk_confidence[i] = sum / float(k1 - k0);
+    }
+  }
+
+  // 6. Post-process: merge repeats → spans → word timestamps (on token ids)
+  std::vector<TokenSpan>& spans = ws.spans;
+  get_token_spans(path, plan.targets.data(), plan.token_offsets.data() + 2 * chunk_begin, num_entries, ctx.blank_id,
+                  spans, ws.span);
+  std::vector<WordTimestamp>& word_ts = ws.word_ts;
+  postprocess_results(text_starred, num_entries, spans, stride_ms, scores,
+                      ctx.posterior_confidence ? &chunk_confidence : nullptr, word_ts);
+
+  // Apply time offset for this slice
+  const double time_offset = double(job.frame_off) * double(stride_ms) / 1000.0;
+  for (auto& w : word_ts) {
+    w.start_sec += time_offset;
+    w.end_sec += time_offset;
+  }
+
+  // 7. Map word timestamps back to SRT segments
+  size_t char_idx = 0;
+  for (size_t si = job.seg_begin; si < job.seg_end; ++si) {
+    SrtSegment& seg = segs[si];
+    const size_t num_chars = utf8::codepoint_count(plan.seg_text(si));
+    if (num_chars == 0 || char_idx >= word_ts.size()) continue;
+
+    if (char_idx > 0 && char_idx < word_ts.size()) {
+      const std::string_view t = word_ts[char_idx].text;
+      size_t l = 0;
+      while (l < t.size() && std::isspace(static_cast<unsigned char>(t[l]))) l++;
+      size_t r2 = t.size();
+      while (r2 > l && std::isspace(static_cast<unsigned char>(t[r2 - 1]))) r2--;
+      if (r2 <= l) char_idx += 1;
+    }
+    if (char_idx >= word_ts.size()) continue;
+
+    const size_t start_idx = char_idx;
+    seg.start_sec = word_ts[char_idx].start_sec;
+    const size_t end_idx = std::min(char_idx + num_chars - 1, word_ts.size() - 1);
+    seg.end_sec = word_ts[end_idx].end_sec;
+
+    // Confidence score
+    auto has_content_char = [&vocab = ctx.vocab](std::string_view s) {
+      for (std::string_view ch : utf8::chars(s)) {
+        if (vocab.token_id(ch) >= 0 || vocab.lower_char_id(utf8::to_codepoint(ch)) >= 0) return true;
+      }
+      for (std::string_view ch : utf8::chars(s)) {
+        if (ch.size() == 1) {
+          char c = ch[0];
+          if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) return true;
+          continue;
+        }
+        uint32_t cp = utf8::to_codepoint(ch);
+        if ((cp >= 0x2000 && cp <= 0x206F) || (cp >= 0x3000 && cp <= 0x303F) ||
+            (cp >= 0xFE30 && cp <= 0xFE6F) || (cp >= 0xFF01 && cp <= 0xFF0F) ||
+            (cp >= 0xFF1A && cp <= 0xFF20) || (cp >= 0xFF3B && cp <= 0xFF40) ||
+            (cp >= 0xFF5B && cp <= 0xFF65))
+          continue;
+        return true;
+      }
+      return false;
+    };
+    std::vector<float>& token_probs = ws.token_probs;
+    token_probs.clear();
+    for (size_t wi = start_idx; wi <= end_idx && wi < word_ts.size(); ++wi) {
+      const auto& wt = word_ts[wi];
+      if (!has_content_char(wt.text)) continue;
+      if (ctx.posterior_confidence) {
+        if (wt.confidence >= 0.0f) token_probs.push_back(wt.confidence);
+        continue;
+      }
+      float tlp = wt.score;
+      if (tlp >= 0.0f) { token_probs.push_back(0.0f); continue; }
+      float dur = static_cast<float>(wt.end_sec - wt.start_sec);
+      int nf = std::max(1, static_cast<int>(dur / 0.02f));
+      float avg = tlp / static_cast<float>(nf);
+      token_probs.push_back(std::max(0.0f, std::min(1.0f, 1.0f + avg / ctx.log_vocab)));
+    }
+    if (!token_probs.empty()) {
+      float sum = 0.0f;
+      for (float p : token_probs) sum += p;
+      seg.score = sum / static_cast<float>(token_probs.size());
+    } else {
+      seg.score = 0.0f;
+    }
+    char_idx = end_idx + 1;
+  }
+}
+
+}  // namespace
+
+void align_segments(
+    std::vector<SrtSegment>& segs,
+    const float* log_probs,
+    int64_t frames,
+    int64_t classes,
+    int stride_ms,
+    const Vocab& vocab,
+    const PreprocessConfig& prep_config,
+    const ModelConfig& model_config,
+    bool posterior_confidence,
+    int threads,
+    Logger& log) {
+  if (segs.empty() || frames <= 0) return;
+
+  const TokenPlan plan = build_token_plan(segs, vocab, prep_config, threads);
+  std::vector<AlignJob> jobs;
+  plan_jobs(segs, plan, 0, segs.size(), 0, frames, stride_ms, log, 0, jobs);
+  if (jobs.empty()) return;
+
+  AlignContext ctx{plan, log_probs, classes, stride_ms, vocab, posterior_confidence, -1, 0.0f};
+  // Runs labelled with the model's blank token are padding between tokens
+  const int64_t blank_id = vocab.token_id(model_config.type == ModelType::MMS_300M ? "<blank>" : "<s>");
+  if (blank_id >= 0) ctx.blank_id = blank_id;
+  ctx.log_vocab = std::log(static_cast<float>(vocab.vocab_size()));
+
+  // Jobs cover disjoint segment ranges, so they can write their results concurrently.
+  parallel_for(jobs.size(), threads, /*grain=*/1, [&](size_t j) {
+    WorkspaceLease ws;
+    run_job(segs, ctx, jobs[j], *ws);
+  });
+
+  for (const auto& job : jobs) {
+    if (!job.debug.empty()) log.debug(job.debug);
+  }
+  {
+    const auto st = workspace_pool().stats();
+    std::ostringstream ss;
+    ss << "[workspace] " << jobs.size() << " jobs; high-water " << st.peak_bytes << " bytes per workspace, "
+       << st.peak_total_bytes << " bytes over " << st.workspaces << " workspaces";
+    log.debug(ss.str());
+  }
+}
+
+AlignWorkspaceStats align_workspace_stats() {
+  return workspace_pool().stats();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "logger.h"
+#include "model_config.h"
+#include "srt_io.h"
+#include "text_preprocess.h"
+#include "vocab.h"
+
+// Align segments against an emission matrix (frames x classes, star column included) and
+// write the new start/end/score back into `segs`.
+//
+// The transcript is preprocessed and tokenized once into a per-segment token-range table
+// (segments are preprocessed concurrently and concatenated in order).
+// Where the CTC constraint T >= L + R fails, the segment range is split at the middle
+// segment (frame boundary halfway between the two neighbouring timestamps) until every
+// range fits; ranges that cannot be split further keep their original timestamps. The
+// resulting ranges are independent and are aligned concurrently. Both stages use up to
+// `threads` threads (<= 0: hardware concurrency). Each running range leases its trellis,
+// path and span buffers from a process-wide workspace pool, so repeated calls reuse them.
+void align_segments(
+    std::vector<SrtSegment>& segs,
+    const float* log_probs,
+    int64_t frames,
+    int64_t classes,
+    int stride_ms,
+    const Vocab& vocab,
+    const PreprocessConfig& prep_config,
+    const ModelConfig& model_config,
+    bool posterior_confidence,
+    int threads,
+    Logger& log);
+
+// Counters of the alignment workspace pool since process start.
+struct AlignWorkspaceStats {
+  uint64_t jobs = 0;              // ranges aligned
+  size_t workspaces = 0;          // workspaces created
+  size_t peak_bytes = 0;          // largest single workspace
+  size_t peak_total_bytes = 0;    // largest sum over all workspaces alive at once
+  size_t retained_bytes = 0;      // currently held by idle workspaces
+};
+
+AlignWorkspaceStats align_workspace_stats();
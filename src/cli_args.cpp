@@ -50,8 +50,12 @@ void print_version() {
 void print_usage() {
   std::cerr << "Usage:\n";
   std::cerr << "  cpp-ort-aligner --audio <path> --model <model_dir> [--srt <path> | --json-input <path|-}] [options]\n";
+  std::cerr << "  cpp-ort-aligner --manifest <path> --model <model_dir> [options]\n";
+  std::cerr << "  cpp-ort-aligner --dataset <path> --model <model_dir> [--batch-size N] [--json-output <path>]\n";
+  std::cerr << "  cpp-ort-aligner --serve --model <model_dir> [--socket <path>] [--jobs N] [options]\n";
   std::cerr << "\nInput/Output:\n";
-  std::cerr << "  --audio, -a           Audio file path\n";
+  std::cerr << "  --audio, -a           Audio file path, or '-' for stdin. Also takes .npy arrays and headerless\n";
+  std::cerr << "                        16 kHz mono PCM (.raw/.pcm or with --pcm-format), read in place\n";
   std::cerr << "  --model, -m           Local model directory (contains model.onnx + vocab.json)\n";
   std::cerr << "  --srt, -s             Input SRT file (required unless using --json-input)\n";
   std::cerr << "  --output, -o          Output SRT path (default: <input>_aligned.srt)\n";
@@ -63,6 +67,34 @@ void print_usage() {
   std::cerr << "  --pinyin-table        Kanji-to-pinyin table path (default: <exe_dir>/Chinese_to_Pinyin.txt)\n";
   std::cerr << "  --batch-size, -b      Inference batch size (default: 4)\n";
   std::cerr << "  --threads             ORT intra-op threads (default: auto)\n";
+  std::cerr << "  --confidence          Segment score: viterbi | posterior (default: viterbi); posterior adds a\n";
+  std::cerr << "                        forward-backward pass costing 2-4x the Viterbi alignment\n";
+  std::cerr << "  --resampler           Conversion of non-16 kHz audio: linear | polyphase (default: linear)\n";
+  std::cerr << "\nLong audio:\n";
+  std::cerr << "  --long-form           Decode, infer and align in sections placed by segment timestamps\n";
+  std::cerr << "                        (bounded memory for multi-hour recordings)\n";
+  std::cerr << "  --section-seconds     Target section length for --long-form (default: 600)\n";
+  std::cerr << "\nPartial alignment:\n";
+  std::cerr << "  --start, --end        Decode and align only this time range (seconds); segments inside it are\n";
+  std::cerr << "                        re-timed in absolute time, the others are written back as read (no score)\n";
+  std::cerr << "  --segment-range       Range = the input segments' span plus 10 s on each side; all are re-timed\n";
+  std::cerr << "\nStreaming:\n";
+  std::cerr << "  --stream              Live mode: raw 16 kHz mono PCM from --audio, JSON-lines segments from\n";
+  std::cerr << "                        --json-input (either may be '-' for stdin); JSON lines to --json-output\n";
+  std::cerr << "  --max-latency         Max seconds before a segment timing is committed (default: 4)\n";
+  std::cerr << "  --stream-window       Inference window in seconds (default: 2)\n";
+  std::cerr << "  --pcm-format          Raw PCM sample format: s16le | f32le (default: s16le); outside --stream\n";
+  std::cerr << "                        it marks --audio as raw PCM\n";
+  std::cerr << "\nMany files:\n";
+  std::cerr << "  --manifest            JSON-lines file of {\"audio\", \"srt\" | \"json_input\", \"output\", \"language\"}\n";
+  std::cerr << "                        entries, aligned in one process with decode/inference/alignment overlapped\n";
+  std::cerr << "  --dataset             Like --manifest for many short clips (entries may give \"text\"): run as\n";
+  std::cerr << "                        length-bucketed --batch-size batches, JSON lines to --json-output\n";
+  std::cerr << "\nServer:\n";
+  std::cerr << "  --serve               Keep the model loaded and align JSON-lines jobs from stdin (replies on\n";
+  std::cerr << "                        stdout) or --socket; --audio/--srt are then given per job\n";
+  std::cerr << "  --socket              Unix socket path to accept jobs on instead of stdin\n";
+  std::cerr << "  --jobs                Jobs aligned concurrently in --serve (default: 2)\n";
   std::cerr << "\nDebug:\n";
   std::cerr << "  --debug, -d           Enable debug mode and save intermediate files\n";
   std::cerr << "  --debug-dir           Debug output directory (default: <base>_debug)\n";
@@ -122,6 +154,41 @@ bool parse_cli_args(int argc, char** argv, CliArgs& out, int& exit_code) {
       out.batch_size = std::stoi(require_value(i, argc, argv, a));
     } else if (a == "--threads") {
       out.threads = std::stoi(require_value(i, argc, argv, a));
+    } else if (a == "--confidence") {
+      out.confidence = require_value(i, argc, argv, a);
+    } else if (a == "--resampler") {
+      out.resampler = require_value(i, argc, argv, a);
+    } else if (a == "--start") {
+      out.range_start = std::stod(require_value(i, argc, argv, a));
+      if (out.range_start < 0.0) throw std::runtime_error("--start must not be negative");
+    } else if (a == "--end") {
+      out.range_end = std::stod(require_value(i, argc, argv, a));
+      if (out.range_end < 0.0) throw std::runtime_error("--end must not be negative");
+    } else if (a == "--segment-range") {
+      out.segment_range = true;
+    } else if (a == "--long-form") {
+      out.long_form = true;
+    } else if (a == "--section-seconds") {
+      out.section_seconds = std::stod(require_value(i, argc, argv, a));
+    } else if (a == "--stream") {
+      out.stream = true;
+    } else if (a == "--max-latency") {
+      out.max_latency = std::stod(require_value(i, argc, argv, a));
+    } else if (a == "--stream-window") {
+      out.stream_window = std::stoi(require_value(i, argc, argv, a));
+    } else if (a == "--manifest") {
+      out.manifest = fs::path(require_value(i, argc, argv, a));
+    } else if (a == "--dataset") {
+      out.dataset = fs::path(require_value(i, argc, argv, a));
+    } else if (a == "--serve") {
+      out.serve = true;
+    } else if (a == "--socket") {
+      out.socket = fs::path(require_value(i, argc, argv, a));
+    } else if (a == "--jobs") {
+      out.serve_jobs = std::stoi(require_value(i, argc, argv, a));
+    } else if (a == "--pcm-format") {
+      out.pcm_format = require_value(i, argc, argv, a);
+      out.raw_pcm = true;
     } else if (a == "--keep-wav") {
       // Python-only feature (ffmpeg conversion). No-op in C++ version for CLI compatibility.
     } else if (a == "--debug" || a == "-d") {
@@ -145,8 +212,35 @@ bool parse_cli_args(int argc, char** argv, CliArgs& out, int& exit_code) {
     }
   }
 
+  if ((!out.socket.empty() || out.serve_jobs != 2) && !out.serve) {
+    std::cerr << "ERROR: --socket and --jobs require --serve\n\n";
+    print_usage();
+    exit_code = 2;
+    return false;
+  }
+  // --serve, --manifest and --dataset name their audio and subtitles per job/entry.
+  const int multi_file_modes = int(out.serve) + int(!out.manifest.empty()) + int(!out.dataset.empty());
+  const bool multi_file = multi_file_modes > 0;
+  if (multi_file) {
+    if (multi_file_modes > 1) {
+      std::cerr << "ERROR: --serve, --manifest and --dataset cannot be combined\n\n";
+      print_usage();
+      exit_code = 2;
+      return false;
+    }
+    if (out.long_form || out.has_range() || out.stream || !out.audio.empty() || !out.srt.empty() ||
+        !out.json_input.empty() || (!out.json_output.empty() && out.dataset.empty()) || !out.output.empty()) {
+      std::cerr << "ERROR: --serve, --manifest and --dataset take audio and subtitles per job; drop --audio, "
+                   "--srt, --json-input, --output and mode flags (--json-output only with --dataset)\n\n";
+      print_usage();
+      exit_code = 2;
+      return false;
+    }
+    if (out.serve_jobs < 1) out.serve_jobs = 1;
+  }
+
   // Validate required
-  if (out.audio.empty()) {
+  if (out.audio.empty() && !multi_file) {
     std::cerr << "ERROR: --audio is required\n\n";
     print_usage();
     exit_code = 2;
@@ -160,7 +254,67 @@ bool parse_cli_args(int argc, char** argv, CliArgs& out, int& exit_code) {
   }
 
   const bool json_mode = !out.json_input.empty();
-  if (!json_mode && out.srt.empty()) {
+  const bool audio_stdin = out.audio.string() == "-";
+  if (audio_stdin && out.json_input.string() == "-") {
+    std::cerr << "ERROR: --audio and --json-input cannot both read from stdin\n\n";
+    print_usage();
+    exit_code = 2;
+    return false;
+  }
+  if (audio_stdin && (out.long_form || out.has_range())) {
+    std::cerr << "ERROR: --long-form and time ranges seek in the audio; pass a file rather than stdin\n\n";
+    print_usage();
+    exit_code = 2;
+    return false;
+  }
+  if (out.pcm_format != "s16le" && out.pcm_format != "f32le") {
+    std::cerr << "ERROR: --pcm-format must be 's16le' or 'f32le'\n\n";
+    print_usage();
+    exit_code = 2;
+    return false;
+  }
+  const std::string ext = out.audio.extension().string();
+  if (ext == ".raw" || ext == ".pcm" || ext == ".RAW" || ext == ".PCM") out.raw_pcm = true;
+  if (out.long_form) {
+    if (out.stream) {
+      std::cerr << "ERROR: --long-form and --stream cannot be combined\n\n";
+      print_usage();
+      exit_code = 2;
+      return false;
+    }
+    if (out.section_seconds <= 0.0) out.section_seconds = 600.0;
+  }
+  if (out.has_range()) {
+    if (out.long_form || out.stream) {
+      std::cerr << "ERROR: --start/--end/--segment-range cannot be combined with --long-form or --stream\n\n";
+      print_usage();
+      exit_code = 2;
+      return false;
+    }
+    if (out.segment_range && (out.range_start >= 0.0 || out.range_end >= 0.0)) {
+      std::cerr << "ERROR: --segment-range derives the range itself; drop --start/--end\n\n";
+      print_usage();
+      exit_code = 2;
+      return false;
+    }
+    if (out.range_end >= 0.0 && out.range_end <= std::max(0.0, out.range_start)) {
+      std::cerr << "ERROR: --end must be after --start\n\n";
+      print_usage();
+      exit_code = 2;
+      return false;
+    }
+  }
+  if (out.stream) {
+    if (!json_mode) {
+      std::cerr << "ERROR: --stream requires --json-input (JSON-lines transcript source)\n\n";
+      print_usage();
+      exit_code = 2;
+      return false;
+    }
+    if (out.max_latency <= 0.0) out.max_latency = 4.0;
+    if (out.stream_window < 1) out.stream_window = 1;
+  }
+  if (!json_mode && out.srt.empty() && !multi_file) {
     std::cerr << "ERROR: Either --srt or --json-input is required\n\n";
     print_usage();
     exit_code = 2;
@@ -169,6 +323,20 @@ bool parse_cli_args(int argc, char** argv, CliArgs& out, int& exit_code) {
 
   if (out.batch_size < 1) out.batch_size = 1;
 
+  if (out.confidence != "viterbi" && out.confidence != "posterior") {
+    std::cerr << "ERROR: --confidence must be 'viterbi' or 'posterior'\n\n";
+    print_usage();
+    exit_code = 2;
+    return false;
+  }
+
+  if (out.resampler != "linear" && out.resampler != "polyphase") {
+    std::cerr << "ERROR: --resampler must be 'linear' or 'polyphase'\n\n";
+    print_usage();
+    exit_code = 2;
+    return false;
+  }
+
   if (out.output.empty() && !out.srt.empty()) {
     out.output = default_output_srt(out.srt);
   }
@@ -16,6 +16,36 @@ struct CliArgs {
   bool romanize = false;
   int batch_size = 4;
   int threads = 0;  // 0 means auto
+  std::string confidence = "viterbi";  // "viterbi" (path frame scores) or "posterior" (forward-backward)
+  std::string resampler = "linear";    // "linear" (miniaudio) or "polyphase" (windowed-sinc FIR)
+
+  // Long-form mode: decode/infer/align in sections placed by segment timestamps
+  bool long_form = false;
+  double section_seconds = 600.0;
+
+  // Range mode: decode, infer and align only [range_start, range_end) seconds of the audio
+  double range_start = -1.0;   // < 0: unset (start of the audio)
+  double range_end = -1.0;     // < 0: unset (end of the audio)
+  bool segment_range = false;  // derive the range from the input segments' span
+  bool has_range() const { return range_start >= 0.0 || range_end >= 0.0 || segment_range; }
+
+  // Streaming mode: PCM from --audio, JSON-lines transcript pieces from --json-input
+  bool stream = false;
+  double max_latency = 4.0;         // seconds an uncommitted frame may wait before a forced commit
+  int stream_window = 2;            // seconds of audio per inference window
+  std::string pcm_format = "s16le"; // raw PCM sample format: s16le | f32le
+  // Server mode: JSON-lines jobs on stdin/stdout, or from clients of a Unix socket
+  bool serve = false;
+  std::filesystem::path socket;  // empty: stdin/stdout
+  int serve_jobs = 2;            // jobs aligned concurrently
+
+  // Manifest mode: align every (audio, subtitle, output, language) entry of a JSON-lines file
+  std::filesystem::path manifest;
+  // Dataset mode: short clips from a manifest, run through the model in length-bucketed batches
+  std::filesystem::path dataset;
+
+  // Batch modes: --audio is headerless 16 kHz mono PCM (set by --pcm-format or a .raw/.pcm name)
+  bool raw_pcm = false;
 
   bool debug = false;
   std::filesystem::path debug_dir;
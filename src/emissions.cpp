@@ -1,11 +1,15 @@
 #include "emissions.h"
+#include "bounded_queue.h"
 
 #include <algorithm>
 #include <cmath>
 #include <chrono>
+#include <exception>
+#include <iterator>
 #include <numeric>
 #include <stdexcept>
 #include <iostream>
+#include <thread>
 
 static void log_softmax_row_into(const float* row, size_t n, float* out) {
   float m = row[0];
@@ -16,10 +20,88 @@ static void log_softmax_row_into(const float* row, size_t n, float* out) {
   for (size_t i = 0; i < n; ++i) out[i] = row[i] - lse;
 }
 
-static int time_to_frame(float seconds) {
+// Appends rows [start, stop) of a chunk's raw logits to `out`, log-softmaxed and each
+// followed by the star column.
+static void append_log_prob_rows(
+    const float* logits, int64_t classes, int64_t start, int64_t stop, float star_logp, std::vector<float>& out) {
+  const size_t base = out.size();
+  out.resize(base + size_t((stop - start) * (classes + 1)));
+  float* outp = out.data() + base;
+  for (int64_t f = start; f < stop; ++f) {
+    log_softmax_row_into(logits + size_t(f * classes), size_t(classes), outp);
+    outp += classes;
+    *outp++ = star_logp;
+  }
+}
+
+// Rows of a chunk kept after trimming `cf` context frames on each side (python: [cf:-cf + 1]).
+static void trimmed_rows(int64_t frames, int64_t cf, int64_t& start, int64_t& stop) {
+  start = 0;
+  stop = frames;
+  if (cf > 0) {
+    start = cf;
+    stop = frames - cf + 1;
+    if (stop < start) stop = start;
+  }
+}
+
+// Run one [batch, samples] input; returns raw logits (batch x frames x classes, row-major).
+static std::vector<float> run_batch_logits(
+    Ort::Session& session,
+    const char* input_name,
+    const char* output_name,
+    const float* x,
+    size_t batch,
+    size_t n,
+    int64_t& frames,
+    int64_t& classes) {
+  Ort::MemoryInfo mem = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+  const char* input_names[] = {input_name};
+  const char* output_names[] = {output_name};
+  std::vector<int64_t> input_shape{int64_t(batch), int64_t(n)};
+  // Input tensors are only read; the cast lets chunks point straight into the caller's waveform.
+  Ort::Value input_tensor = Ort::Value::CreateTensor<float>(mem, const_cast<float*>(x), batch * n,
+                                                            input_shape.data(), input_shape.size());
+  auto outputs = session.Run(Ort::RunOptions{nullptr}, input_names, &input_tensor, 1, output_names, 1);
+  if (outputs.empty()) throw std::runtime_error("ORT returned no outputs");
+
+  auto& out0 = outputs[0];
+  auto ti = out0.GetTensorTypeAndShapeInfo();
+  auto shape = ti.GetShape();  // [batch, frames, classes]
+  if (shape.size() != 3) throw std::runtime_error("Unexpected logits rank");
+  if (shape[0] != int64_t(batch)) throw std::runtime_error("Unexpected logits batch dim");
+  frames = shape[1];
+  classes = shape[2];
+  const float* logits = out0.GetTensorData<float>();
+  return std::vector<float>(logits, logits + size_t(int64_t(batch) * frames * classes));
+}
+
+// Run one [1, samples] chunk; returns raw logits (frames x classes, row-major).
+static std::vector<float> run_chunk_logits(
+    Ort::Session& session,
+    const char* input_name,
+    const char* output_name,
+    const float* x,
+    size_t n,
+    int64_t& frames,
+    int64_t& classes) {
+  return run_batch_logits(session, input_name, output_name, x, 1, n, frames, classes);
+}
+
+// Frames the wav2vec2 feature encoder (MMS, Omnilingual) yields for `samples` of input: its conv
+// layers add up to a 400-sample receptive field and a 320-sample stride.
+static int64_t encoder_frames(int64_t samples) {
+  static constexpr int64_t kKernel[] = {10, 3, 3, 3, 3, 2, 2};
+  static constexpr int64_t kStride[] = {5, 2, 2, 2, 2, 2, 2};
+  int64_t n = samples;
+  for (size_t i = 0; i < std::size(kKernel) && n > 0; ++i) n = n < kKernel[i] ? 0 : (n - kKernel[i]) / kStride[i] + 1;
+  return n;
+}
+
+static int64_t time_to_frame(float seconds) {
   const int stride_msec = 20;
   const float frames_per_sec = 1000.0f / float(stride_msec);
-  return int(seconds * frames_per_sec);
+  return int64_t(seconds * frames_per_sec);
 }
 
 Emissions generate_emissions_ort(
@@ -29,6 +111,18 @@ Emissions generate_emissions_ort(
     int context_seconds,
     int batch_size,
     float star_logp) {
+  return generate_emissions_ort(session, waveform_16k_mono.data(), waveform_16k_mono.size(), window_seconds,
+                                context_seconds, batch_size, star_logp);
+}
+
+Emissions generate_emissions_ort(
+    Ort::Session& session,
+    const float* samples,
+    size_t num_samples,
+    int window_seconds,
+    int context_seconds,
+    int batch_size,
+    float star_logp) {
   const bool profile = std::getenv("CPP_ORT_ALIGNER_PROFILE") != nullptr;
   const auto t0 = std::chrono::steady_clock::now();
   auto t_last = t0;
@@ -42,151 +136,397 @@ Emissions generate_emissions_ort(
   };
 
   if (batch_size < 1) batch_size = 1;
-  const int sample_rate = 16000;
-  const int window = window_seconds * sample_rate;
-  const int context = context_seconds * sample_rate;
-
-  std::vector<std::vector<float>> chunks;
-  int extension = 0;
-  int used_context = 0;
-
-  if (int(waveform_16k_mono.size()) < window) {
-    used_context = 0;
-    extension = 0;
-    chunks.push_back(waveform_16k_mono);
-  } else {
+  // 64-bit sample/frame arithmetic: int overflows after ~37 h of 16 kHz audio.
+  const int64_t sample_rate = 16000;
+  const int64_t window = int64_t(window_seconds) * sample_rate;
+  const int64_t context = int64_t(context_seconds) * sample_rate;
+  const int64_t t = int64_t(num_samples);
+
+  // Chunk i covers [i * stride, i * stride + chunk_samples) of the waveform padded with
+  // used_context zeros in front and used_context + extension zeros behind. The padding is
+  // virtual: chunks inside the waveform are read in place, only the edge chunks are staged.
+  int64_t extension = 0;
+  int64_t used_context = 0;
+  int64_t chunk_samples = t;
+  int64_t num_chunks = 1;
+
+  if (t >= window) {
     used_context = context;
-    const int t = int(waveform_16k_mono.size());
-    const int nwin = int(std::ceil(double(t) / double(window)));
+    const int64_t nwin = int64_t(std::ceil(double(t) / double(window)));
     extension = nwin * window - t;
 
-    std::vector<float> padded;
-    padded.reserve(size_t(used_context + t + used_context + extension));
-    padded.insert(padded.end(), size_t(used_context), 0.0f);
-    padded.insert(padded.end(), waveform_16k_mono.begin(), waveform_16k_mono.end());
-    padded.insert(padded.end(), size_t(used_context + extension), 0.0f);
-
-    const int chunk_samples = window + 2 * used_context;
-    const int stride = window;
-    const int num_chunks = (int(padded.size()) - chunk_samples) / stride + 1;
-    chunks.reserve(size_t(num_chunks));
-    for (int i = 0; i < num_chunks; ++i) {
-      const int start = i * stride;
-      chunks.emplace_back(padded.begin() + start, padded.begin() + start + chunk_samples);
-    }
+    chunk_samples = window + 2 * used_context;
+    num_chunks = (used_context + t + used_context + extension - chunk_samples) / window + 1;
   }
+  const int64_t stride = window;
+  std::vector<float> staged;
+  auto chunk_data = [&](int64_t j) -> const float* {
+    const int64_t begin = j * stride - used_context;  // in waveform samples
+    if (begin >= 0 && begin + chunk_samples <= t) return samples + begin;
+    staged.assign(size_t(chunk_samples), 0.0f);
+    const int64_t lo = std::max<int64_t>(begin, 0);
+    const int64_t hi = std::min(begin + chunk_samples, t);
+    if (hi > lo) std::copy(samples + lo, samples + hi, staged.begin() + (lo - begin));
+    return staged.data();
+  };
   mark("chunking");
 
   // ORT names
   Ort::AllocatorWithDefaultOptions allocator;
   auto input_name = session.GetInputNameAllocated(0, allocator);
   auto output_name = session.GetOutputNameAllocated(0, allocator);
-  const char* input_names[] = {input_name.get()};
-  const char* output_names[] = {output_name.get()};
 
-  Ort::MemoryInfo mem = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+  if (profile) {
+    std::cerr << "[profile] chunks=" << num_chunks << " window_s=" << window_seconds << " context_s=" << context_seconds
+              << " batch_size=" << batch_size << "\n";
+  }
 
-  std::vector<std::vector<float>> logits_chunks;  // each: frames x 31 (row-major)
+  // Each chunk is trimmed of its context frames and log-softmaxed (+ star column) straight
+  // into the output, so only one chunk's raw logits are alive at a time.
+  const int64_t cf = used_context > 0 ? time_to_frame(float(context_seconds)) : 0;
+  const int64_t expected_frames = time_to_frame(float(double(t) / double(sample_rate))) + 1;
   int64_t classes = -1;
+  int64_t total_frames = 0;
+  std::vector<float> log_probs;
 
-  if (profile) {
-    std::cerr << "[profile] chunks=" << chunks.size() << " window_s=" << window_seconds << " context_s=" << context_seconds
-              << " batch_size=" << batch_size << "\n";
+  // Up to batch_size chunks per Run(); a lone chunk is still read in place.
+  std::vector<float> batch_input;
+  for (int64_t i = 0; i < num_chunks; i += batch_size) {
+    const int64_t end = std::min(num_chunks, i + int64_t(batch_size));
+    const size_t batch = size_t(end - i);
+    const float* x = nullptr;
+    if (batch == 1) {
+      x = chunk_data(i);
+    } else {
+      batch_input.resize(batch * size_t(chunk_samples));
+      for (int64_t j = i; j < end; ++j) {
+        const float* chunk = chunk_data(j);
+        std::copy(chunk, chunk + chunk_samples, batch_input.begin() + (j - i) * chunk_samples);
+      }
+      x = batch_input.data();
+    }
+    int64_t frames = 0;
+    int64_t c = 0;
+    const auto logits =
+        run_batch_logits(session, input_name.get(), output_name.get(), x, batch, size_t(chunk_samples), frames, c);
+    if (classes < 0) {
+      classes = c;
+      log_probs.reserve(size_t(expected_frames * (classes + 1)));
+    }
+    if (classes != c) throw std::runtime_error("Inconsistent class dim across chunks");
+
+    int64_t start = 0;
+    int64_t stop = 0;
+    trimmed_rows(frames, cf, start, stop);
+    for (size_t b = 0; b < batch; ++b) {
+      append_log_prob_rows(logits.data() + b * size_t(frames * classes), classes, start, stop, star_logp, log_probs);
+      total_frames += stop - start;
+    }
   }
+  mark("ort_run+trim+log_softmax+star");
+
+  if (classes <= 0) throw std::runtime_error("No logits produced");
+  const int64_t classes_with_star = classes + 1;
 
-  for (size_t i = 0; i < chunks.size(); i += size_t(batch_size)) {
-    const size_t end = std::min(chunks.size(), i + size_t(batch_size));
-    // Process each chunk separately for simplicity (batch_size currently only affects loop chunking).
-    for (size_t j = i; j < end; ++j) {
-      auto& x = chunks[j];
-      std::vector<int64_t> input_shape{1, int64_t(x.size())};
-      Ort::Value input_tensor = Ort::Value::CreateTensor<float>(
-          mem, x.data(), x.size(), input_shape.data(), input_shape.size());
-      auto outputs = session.Run(Ort::RunOptions{nullptr}, input_names, &input_tensor, 1, output_names, 1);
-      if (outputs.empty()) throw std::runtime_error("ORT returned no outputs");
-
-      auto& out0 = outputs[0];
-      auto ti = out0.GetTensorTypeAndShapeInfo();
-      auto shape = ti.GetShape();  // [1, frames, 31]
-      if (shape.size() != 3) throw std::runtime_error("Unexpected logits rank");
-      const int64_t frames = shape[1];
-      const int64_t c = shape[2];
-      if (classes < 0) classes = c;
-      if (classes != c) throw std::runtime_error("Inconsistent class dim across chunks");
-
-      const float* logits = out0.GetTensorData<float>();
-      logits_chunks.emplace_back(logits, logits + size_t(frames * c));
+  // Remove extension frames.
+  const int64_t ext_frames = extension > 0 ? time_to_frame(float(extension) / float(sample_rate)) : 0;
+  if (ext_frames > 0) {
+    const int64_t keep_frames = total_frames - ext_frames;
+    if (keep_frames > 0) {
+      log_probs.resize(size_t(keep_frames * classes_with_star));
+      total_frames = keep_frames;
     }
   }
-  mark("ort_run+copy_logits");
+  mark("remove_extension");
+
+  Emissions out;
+  out.frames = total_frames;
+  out.classes = classes_with_star;
+  out.log_probs = std::move(log_probs);
+  out.stride_ms = 20;
+  mark("done");
+  return out;
+}
 
+std::vector<Emissions> generate_emissions_batch(
+    Ort::Session& session,
+    const std::vector<const float*>& clips,
+    const std::vector<size_t>& lengths,
+    float star_logp) {
+  if (clips.empty()) return {};
+  if (clips.size() != lengths.size()) throw std::runtime_error("clips and lengths differ in size");
+  const size_t batch = clips.size();
+  const size_t n = *std::max_element(lengths.begin(), lengths.end());
+  std::vector<float> staged(batch * n, 0.0f);
+  for (size_t b = 0; b < batch; ++b) std::copy(clips[b], clips[b] + lengths[b], staged.begin() + b * n);
+
+  Ort::AllocatorWithDefaultOptions allocator;
+  auto input_name = session.GetInputNameAllocated(0, allocator);
+  auto output_name = session.GetOutputNameAllocated(0, allocator);
+  int64_t frames = 0;
+  int64_t classes = 0;
+  const auto logits =
+      run_batch_logits(session, input_name.get(), output_name.get(), staged.data(), batch, n, frames, classes);
   if (classes <= 0) throw std::runtime_error("No logits produced");
 
-  // Remove context frames per chunk and flatten.
-  const int cf = used_context > 0 ? time_to_frame(float(context_seconds)) : 0;
-  // We can compute total frames after trimming without materializing trimmed chunks.
+  std::vector<Emissions> out(batch);
+  for (size_t b = 0; b < batch; ++b) {
+    // Keep as many frames as the clip gives on its own; the rest lie in its padding.
+    const int64_t pad_frames = encoder_frames(int64_t(n)) - encoder_frames(int64_t(lengths[b]));
+    const int64_t keep = std::max<int64_t>(0, frames - pad_frames);
+    Emissions& em = out[b];
+    append_log_prob_rows(logits.data() + size_t(int64_t(b) * frames * classes), classes, 0, keep, star_logp,
+                         em.log_probs);
+    em.frames = keep;
+    em.classes = classes + 1;
+    em.stride_ms = 20;
+  }
+  return out;
+}
+
+Emissions generate_emissions_pipelined(
+    Ort::Session& session,
+    const std::function<std::vector<float>()>& read_block,
+    int window_seconds,
+    int context_seconds,
+    int batch_size,
+    float star_logp,
+    int64_t& num_samples) {
+  constexpr size_t kQueuedBlocks = 4;  // decoded blocks waiting for ORT
+  constexpr size_t kQueuedChunks = 2;  // raw logits of a batch waiting for post-processing
+  if (batch_size < 1) batch_size = 1;
+  using clock = std::chrono::steady_clock;
+  auto seconds_since = [](clock::time_point t) { return std::chrono::duration<double>(clock::now() - t).count(); };
+  const auto t_begin = clock::now();
+
+  const int64_t sample_rate = 16000;
+  const int64_t window = int64_t(window_seconds) * sample_rate;
+  const int64_t context = int64_t(context_seconds) * sample_rate;
+
+  Ort::AllocatorWithDefaultOptions allocator;
+  auto input_name = session.GetInputNameAllocated(0, allocator);
+  auto output_name = session.GetOutputNameAllocated(0, allocator);
+
+  struct ChunkLogits {
+    std::vector<float> logits;  // batch x frames x classes
+    int64_t batch = 1;
+    int64_t frames = 0;
+    int64_t classes = 0;
+    int64_t cf = 0;  // context frames to trim on each side
+  };
+  BoundedQueue<std::vector<float>> blocks(kQueuedBlocks);
+  BoundedQueue<ChunkLogits> chunks(kQueuedChunks);
+  std::exception_ptr decode_error;
+  std::exception_ptr post_error;
+  double decode_seconds = 0.0;
+  double post_seconds = 0.0;
+
+  std::thread decoder([&] {
+    try {
+      for (;;) {
+        const auto t0 = clock::now();
+        std::vector<float> block = read_block();
+        decode_seconds += seconds_since(t0);
+        if (block.empty() || !blocks.push(std::move(block))) break;
+      }
+    } catch (...) {
+      decode_error = std::current_exception();
+    }
+    blocks.close();
+  });
+
+  int64_t classes = -1;
   int64_t total_frames = 0;
-  {
-    for (const auto& chunk_logits : logits_chunks) {
-      const int64_t frames = int64_t(chunk_logits.size()) / classes;
-      int64_t start = 0;
-      int64_t stop = frames;
-      if (cf > 0) {
-        start = cf;
-        stop = frames - cf + 1;  // python: -cf + 1
-        if (stop < start) stop = start;
+  std::vector<float> log_probs;
+  std::thread post([&] {
+    try {
+      while (auto chunk = chunks.pop()) {
+        const auto t0 = clock::now();
+        if (classes < 0) classes = chunk->classes;
+        if (classes != chunk->classes) throw std::runtime_error("Inconsistent class dim across chunks");
+        int64_t start = 0;
+        int64_t stop = 0;
+        trimmed_rows(chunk->frames, chunk->cf, start, stop);
+        for (int64_t b = 0; b < chunk->batch; ++b) {
+          append_log_prob_rows(chunk->logits.data() + size_t(b * chunk->frames * classes), classes, start, stop,
+                               star_logp, log_probs);
+          total_frames += stop - start;
+        }
+        post_seconds += seconds_since(t0);
       }
-      total_frames += (stop - start);
+    } catch (...) {
+      post_error = std::current_exception();
+      chunks.close();
     }
-  }
+  });
 
-  std::vector<float> flat_logits;
-  flat_logits.reserve(size_t(total_frames * classes));
-  for (const auto& chunk_logits : logits_chunks) {
-    const int64_t frames = int64_t(chunk_logits.size()) / classes;
-    int64_t start = 0;
-    int64_t stop = frames;
-    if (cf > 0) {
-      start = cf;
-      stop = frames - cf + 1;  // python: -cf + 1
-      if (stop < start) stop = start;
+  // The ORT stage runs here. Samples [wave_begin, wave_begin + wave.size()) are buffered;
+  // `received` counts all samples so far and is the waveform length once `ended`.
+  std::vector<float> wave;
+  int64_t wave_begin = 0;
+  int64_t received = 0;
+  bool ended = false;
+  double ort_seconds = 0.0;
+  auto pull = [&] {
+    auto block = blocks.pop();
+    if (!block) {
+      ended = true;
+      return;
     }
-    for (int64_t t = start; t < stop; ++t) {
-      const float* row = chunk_logits.data() + size_t(t * classes);
-      flat_logits.insert(flat_logits.end(), row, row + classes);
+    wave.insert(wave.end(), block->begin(), block->end());
+    received += int64_t(block->size());
+  };
+  auto run = [&](const float* x, int64_t batch, int64_t n, int64_t cf) {
+    const auto t0 = clock::now();
+    ChunkLogits chunk;
+    chunk.batch = batch;
+    chunk.cf = cf;
+    chunk.logits = run_batch_logits(session, input_name.get(), output_name.get(), x, size_t(batch), size_t(n),
+                                    chunk.frames, chunk.classes);
+    ort_seconds += seconds_since(t0);
+    return chunks.push(std::move(chunk));
+  };
+
+  int64_t extension = 0;
+  try {
+    // Same chunk layout as generate_emissions_ort(), which depends on whether the waveform is
+    // shorter than one window.
+    while (!ended && received < window) pull();
+    if (received < window) {
+      run(wave.data(), 1, received, 0);
+    } else {
+      const int64_t chunk_samples = window + 2 * context;
+      const int64_t cf = context > 0 ? time_to_frame(float(context_seconds)) : 0;
+      // Windows are copied into a batch of up to batch_size and run together, as in
+      // generate_emissions_ort(); zeros stand before the start and past the end of the waveform.
+      std::vector<float> batch_input(size_t(batch_size) * size_t(chunk_samples));
+      int64_t pending = 0;
+      for (int64_t j = 0;; ++j) {
+        const int64_t begin = j * window - context;
+        while (!ended && received < begin + chunk_samples) pull();
+        if (j * window >= received) break;  // past the last window
+
+        float* slot = batch_input.data() + pending * chunk_samples;
+        std::fill(slot, slot + chunk_samples, 0.0f);
+        const int64_t lo = std::max(begin, wave_begin);
+        const int64_t hi = std::min(begin + chunk_samples, wave_begin + int64_t(wave.size()));
+        if (hi > lo) std::copy(wave.begin() + (lo - wave_begin), wave.begin() + (hi - wave_begin), slot + (lo - begin));
+        if (++pending == batch_size) {
+          const bool accepted = run(batch_input.data(), pending, chunk_samples, cf);
+          pending = 0;
+          if (!accepted) break;
+        }
+
+        // The next window starts `window` later, with its left context.
+        const int64_t keep_from = std::min((j + 1) * window - context, wave_begin + int64_t(wave.size()));
+        if (keep_from > wave_begin) {
+          wave.erase(wave.begin(), wave.begin() + (keep_from - wave_begin));
+          wave_begin = keep_from;
+        }
+      }
+      if (pending > 0) run(batch_input.data(), pending, chunk_samples, cf);
+      const int64_t nwin = (received + window - 1) / window;
+      extension = nwin * window - received;
     }
+  } catch (...) {
+    blocks.close();
+    chunks.close();
+    decoder.join();
+    post.join();
+    throw;
   }
-  mark("trim+flatten");
+  blocks.close();
+  chunks.close();
+  decoder.join();
+  post.join();
+  if (decode_error) std::rethrow_exception(decode_error);
+  if (post_error) std::rethrow_exception(post_error);
+
+  if (classes <= 0) throw std::runtime_error("No logits produced");
+  const int64_t classes_with_star = classes + 1;
 
   // Remove extension frames.
-  const int ext_frames = extension > 0 ? time_to_frame(float(extension) / float(sample_rate)) : 0;
+  const int64_t ext_frames = extension > 0 ? time_to_frame(float(extension) / float(sample_rate)) : 0;
   if (ext_frames > 0) {
     const int64_t keep_frames = total_frames - ext_frames;
     if (keep_frames > 0) {
-      flat_logits.resize(size_t(keep_frames * classes));
+      log_probs.resize(size_t(keep_frames * classes_with_star));
       total_frames = keep_frames;
     }
   }
-  mark("remove_extension");
 
-  // log_softmax + append star.
-  const int64_t classes_with_star = classes + 1;
-  std::vector<float> log_probs;
-  log_probs.resize(size_t(total_frames * classes_with_star));
-  float* outp = log_probs.data();
-  for (int64_t t = 0; t < total_frames; ++t) {
-    const float* row = flat_logits.data() + size_t(t * classes);
-    log_softmax_row_into(row, size_t(classes), outp);
-    outp += classes;
-    *outp++ = star_logp;
+  if (std::getenv("CPP_ORT_ALIGNER_PROFILE") != nullptr) {
+    std::cerr << "[profile] pipeline: wall=" << int64_t(seconds_since(t_begin) * 1000) << "ms decode="
+              << int64_t(decode_seconds * 1000) << "ms ort=" << int64_t(ort_seconds * 1000)
+              << "ms post=" << int64_t(post_seconds * 1000) << "ms\n";
   }
-  mark("log_softmax+star");
 
+  num_samples = received;
   Emissions out;
   out.frames = total_frames;
   out.classes = classes_with_star;
   out.log_probs = std::move(log_probs);
   out.stride_ms = 20;
-  mark("done");
   return out;
 }
+
+StreamingEmissions::StreamingEmissions(
+    Ort::Session& session, int window_seconds, int context_seconds, float star_logp)
+    : session_(session), star_logp_(star_logp) {
+  const int sample_rate = 16000;
+  if (window_seconds < 1) window_seconds = 1;
+  if (context_seconds < 0) context_seconds = 0;
+  window_ = window_seconds * sample_rate;
+  context_ = context_seconds * sample_rate;
+  context_frames_ = context_ > 0 ? time_to_frame(float(context_seconds)) : 0;
+
+  Ort::AllocatorWithDefaultOptions allocator;
+  input_name_ = session.GetInputNameAllocated(0, allocator).get();
+  output_name_ = session.GetOutputNameAllocated(0, allocator).get();
+
+  buf_.reserve(size_t(window_ + 2 * context_));
+  buf_.assign(size_t(context_), 0.0f);  // leading zero context, as in the batch path
+}
+
+void StreamingEmissions::push(const float* samples, size_t n, std::vector<float>& out) {
+  const size_t chunk_samples = size_t(window_ + 2 * context_);
+  while (n > 0) {
+    const size_t take = std::min(n, chunk_samples - buf_.size());
+    buf_.insert(buf_.end(), samples, samples + take);
+    samples += take;
+    n -= take;
+    if (buf_.size() == chunk_samples) {
+      run_window(window_, out);
+      // Keep the last 2*context samples: right context becomes the next window's left context + head.
+      buf_.erase(buf_.begin(), buf_.begin() + window_);
+    }
+  }
+}
+
+void StreamingEmissions::finish(std::vector<float>& out) {
+  const int64_t valid = int64_t(buf_.size()) - context_;
+  if (valid <= 0) return;
+  buf_.resize(size_t(window_ + 2 * context_), 0.0f);
+  run_window(valid, out);
+  buf_.assign(size_t(context_), 0.0f);
+}
+
+void StreamingEmissions::run_window(int64_t valid_samples, std::vector<float>& out) {
+  int64_t frames = 0;
+  int64_t c = 0;
+  const auto logits =
+      run_chunk_logits(session_, input_name_.c_str(), output_name_.c_str(), buf_.data(), buf_.size(), frames, c);
+  if (classes_ == 0) classes_ = c + 1;
+  if (classes_ != c + 1) throw std::runtime_error("Inconsistent class dim across chunks");
+
+  int64_t start = 0;
+  int64_t stop = 0;
+  trimmed_rows(frames, context_frames_, start, stop);
+  // Drop frames that only cover zero padding past the end of the stream.
+  if (valid_samples < window_) {
+    const int64_t ext_frames = time_to_frame(float(window_ - valid_samples) / 16000.0f);
+    stop = std::max(start, stop - ext_frames);
+  }
+
+  append_log_prob_rows(logits.data(), c, start, stop, star_logp_, out);
+}
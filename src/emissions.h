@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <string>
 #include <vector>
 
 #include <onnxruntime_cxx_api.h>
@@ -20,3 +23,70 @@ Emissions generate_emissions_ort(
     int context_seconds,
     int batch_size,
     float star_logp);
+
+// Same over a borrowed waveform (e.g. a memory-mapped file). Windows run batch_size per ORT
+// call; a window run on its own is passed to the model in place.
+Emissions generate_emissions_ort(
+    Ort::Session& session,
+    const float* samples,
+    size_t num_samples,
+    int window_seconds,
+    int context_seconds,
+    int batch_size,
+    float star_logp);
+
+// Emissions for several short clips from one zero-padded [clips, longest] run, for clips shorter
+// than a window (which generate_emissions_ort() also runs whole, without context). Each clip keeps
+// exactly the frames the feature encoder gives for its own length. Attention still sees the
+// padding, so the values can differ slightly from running the clip alone, the less so the closer
+// the clip lengths are.
+std::vector<Emissions> generate_emissions_batch(
+    Ort::Session& session,
+    const std::vector<const float*>& clips,
+    const std::vector<size_t>& lengths,
+    float star_logp);
+
+// generate_emissions_ort() for audio that is still being decoded, as three stages joined by
+// bounded queues: a thread pulls waveform blocks from `read_block` (empty at end of stream), the
+// calling thread runs windows through ORT batch_size at a time as soon as their samples and
+// right context exist, and a third thread trims and log-softmaxes finished windows. Only a few
+// batches of audio and logits are in flight, and the result is identical to
+// generate_emissions_ort() on the whole waveform. Sets `num_samples` to the waveform length.
+Emissions generate_emissions_pipelined(
+    Ort::Session& session,
+    const std::function<std::vector<float>()>& read_block,
+    int window_seconds,
+    int context_seconds,
+    int batch_size,
+    float star_logp,
+    int64_t& num_samples);
+
+// Incremental emissions for live 16 kHz audio, using the same window/context scheme as
+// generate_emissions_ort(): each window is run with context audio on both sides, context
+// frames are trimmed, and rows are log-softmaxed with the star column appended.
+// A window's rows become available once its right context has arrived.
+class StreamingEmissions {
+ public:
+  StreamingEmissions(Ort::Session& session, int window_seconds, int context_seconds, float star_logp);
+
+  // Feed samples; appends finished rows (classes() floats each) to `out`.
+  void push(const float* samples, size_t n, std::vector<float>& out);
+  // End of stream: runs the remaining partial window, zero-padded, and trims padding frames.
+  void finish(std::vector<float>& out);
+
+  int64_t classes() const { return classes_; }  // includes star; 0 until the first window ran
+  int stride_ms() const { return 20; }
+
+ private:
+  void run_window(int64_t valid_samples, std::vector<float>& out);
+
+  Ort::Session& session_;
+  std::string input_name_;
+  std::string output_name_;
+  int window_ = 0;   // samples
+  int context_ = 0;  // samples
+  int64_t context_frames_ = 0;
+  float star_logp_ = 0.0f;
+  int64_t classes_ = 0;
+  std::vector<float> buf_;  // [left context | window | right context], filled incrementally
+};
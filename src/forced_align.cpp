@@ -2,9 +2,96 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
 #include <stdexcept>
 
+namespace {
+
+// Per-frame window [start, end) of trellis states that are both reachable from frame 0 and
+// still able to reach a final state by frame T-1 (torchaudio CPU kernel bookkeeping).
+// forced_align() and ctc_posteriors() walk exactly the same band.
+struct TrellisBand {
+  std::vector<int64_t>& start;
+  std::vector<int64_t>& end;
+};
+
+TrellisBand compute_band(int64_t T, const int64_t* targets, int64_t L, int64_t R, TrellisWorkspace& ws) {
+  const int64_t S = 2 * L + 1;
+  TrellisBand band{ws.band_start, ws.band_end};
+  band.start.resize(size_t(T));
+  band.end.resize(size_t(T));
+
+  int64_t start = (T - (L + R) > 0) ? 0 : 1;
+  int64_t end = (S == 1) ? 1 : 2;
+  band.start[0] = start;
+  band.end[0] = end;
+  for (int64_t t = 1; t < T; ++t) {
+    if (T - t <= L + R) {
+      if ((start % 2 == 1) && (targets[start / 2] != targets[start / 2 + 1])) start = start + 1;
+      start = start + 1;
+    }
+    if (t <= L + R) {
+      if (end % 2 == 0 && end < 2 * L && (targets[end / 2 - 1] != targets[end / 2])) end = end + 1;
+      end = end + 1;
+    }
+    band.start[size_t(t)] = start;
+    band.end[size_t(t)] = end;
+  }
+  return band;
+}
+
+int64_t count_repeats(const int64_t* targets, int64_t L) {
+  int64_t R = 0;
+  for (int64_t i = 1; i < L; ++i) {
+    if (targets[i] == targets[i - 1]) ++R;
+  }
+  return R;
+}
+
+inline float log_add(float a, float b) {
+  const float m = std::max(a, b);
+  if (m == -std::numeric_limits<float>::infinity()) return m;
+  return m + std::log(std::exp(a - m) + std::exp(b - m));
+}
+
+inline float log_add3(float a, float b, float c) {
+  const float m = std::max(a, std::max(b, c));
+  if (m == -std::numeric_limits<float>::infinity()) return m;
+  return m + std::log(std::exp(a - m) + std::exp(b - m) + std::exp(c - m));
+}
+
+// The scaled alphas of ctc_posteriors() need a double's exponent range but only about a float's
+// precision, so each is stored as the upper half of the double: sign, exponent and 20 mantissa bits
+// (rounded to nearest, ~1e-6 relative). Packing and unpacking are a shift, not a log and an exp.
+inline uint32_t pack_prob(double p) {
+  uint64_t bits;
+  std::memcpy(&bits, &p, sizeof bits);
+  return uint32_t((bits + 0x80000000u) >> 32);
+}
+
+inline double unpack_prob(uint32_t packed) {
+  const uint64_t bits = uint64_t(packed) << 32;
+  double p;
+  std::memcpy(&p, &bits, sizeof p);
+  return p;
+}
+
+template <typename T>
+size_t capacity_bytes(const std::vector<T>& v) {
+  return v.capacity() * sizeof(T);
+}
+
+}  // namespace
+
+size_t TrellisWorkspace::bytes() const {
+  return capacity_bytes(band_start) + capacity_bytes(band_end) + capacity_bytes(alphas) + capacity_bytes(back_ptr) +
+         capacity_bytes(state_label) + capacity_bytes(skip) + capacity_bytes(class_prob) + capacity_bytes(emit) +
+         capacity_bytes(row_off) + capacity_bytes(alpha) + capacity_bytes(alpha_scale) +
+         capacity_bytes(log_alpha) + capacity_bytes(prev) + capacity_bytes(cur) + capacity_bytes(beta) +
+         capacity_bytes(next_e) + capacity_bytes(occ) + capacity_bytes(start_acc) + capacity_bytes(end_acc);
+}
+
 std::vector<Segment> merge_repeats(const std::vector<int64_t>& path) {
   std::vector<Segment> segments;
   if (path.empty()) return segments;
@@ -30,39 +117,34 @@ void forced_align(
     int64_t L,
     int64_t blank,
     std::vector<int64_t>& out_path,
-    std::vector<float>& out_scores) {
+    std::vector<float>& out_scores,
+    TrellisWorkspace* ws) {
   if (T <= 0 || C <= 0) throw std::runtime_error("invalid log_probs shape");
   if (L <= 0) throw std::runtime_error("empty targets");
   const float neg_inf = -std::numeric_limits<float>::infinity();
 
   const int64_t S = 2 * L + 1;
 
-  // Count repeats.
-  int64_t R = 0;
-  for (int64_t i = 1; i < L; ++i) {
-    if (targets[i] == targets[i - 1]) ++R;
-  }
+  const int64_t R = count_repeats(targets, L);
   if (T < L + R) throw std::runtime_error("targets length is too long for CTC");
 
-  std::vector<float> alphas(size_t(2 * S), neg_inf);
-  std::vector<int8_t> back_ptr(size_t(T * S), int8_t(-1));
+  TrellisWorkspace local;
+  TrellisWorkspace& w = ws ? *ws : local;
+  const TrellisBand band = compute_band(T, targets, L, R, w);
 
-  int64_t start = (T - (L + R) > 0) ? 0 : 1;
-  int64_t end = (S == 1) ? 1 : 2;
-  for (int64_t i = start; i < end; ++i) {
+  std::vector<float>& alphas = w.alphas;
+  std::vector<int8_t>& back_ptr = w.back_ptr;
+  alphas.assign(size_t(2 * S), neg_inf);
+  back_ptr.assign(size_t(T * S), int8_t(-1));
+
+  for (int64_t i = band.start[0]; i < band.end[0]; ++i) {
     const int64_t label_idx = (i % 2 == 0) ? blank : targets[i / 2];
     alphas[size_t(i)] = log_probs[size_t(0 * C + label_idx)];
   }
 
   for (int64_t t = 1; t < T; ++t) {
-    if (T - t <= L + R) {
-      if ((start % 2 == 1) && (targets[start / 2] != targets[start / 2 + 1])) start = start + 1;
-      start = start + 1;
-    }
-    if (t <= L + R) {
-      if (end % 2 == 0 && end < 2 * L && (targets[end / 2 - 1] != targets[end / 2])) end = end + 1;
-      end = end + 1;
-    }
+    const int64_t start = band.start[size_t(t)];
+    const int64_t end = band.end[size_t(t)];
 
     const int64_t cur_off = t % 2;
     const int64_t prev_off = (t - 1) % 2;
@@ -116,3 +198,355 @@ void forced_align(
   }
 }
 
+
+namespace {
+
+// Sums that ctc_posteriors() turns into TokenPosteriors, filled by either pass below.
+struct PosteriorSums {
+  std::vector<double>& occ;        // L: sum over frames of P(target at t)
+  std::vector<double>& start_acc;  // L: sum of t * P(target entered at t)
+  std::vector<double>& end_acc;    // L: sum of t * P(target left after t)
+  std::vector<float>& peak;        // L
+};
+
+// Forward-backward on probabilities, every row rescaled to a maximum of 1 (Graves et al. 2006):
+// a cell costs a few multiply-adds rather than a log-sum-exp. Cells more than ~e^-708 below their
+// row's maximum flush to zero; that is harmless for the far edges of the band, but would drop the
+// likely paths if a row's best prefix led nowhere. Every frame gives P(targets) = sum_s alpha * beta,
+// so dropped mass shows up as a disagreement with the forward total: the pass then returns false,
+// leaving `sums` partly filled.
+bool scaled_posteriors(
+    const float* log_probs,
+    int64_t T,
+    int64_t C,
+    int64_t S,
+    const TrellisBand& band,
+    TrellisWorkspace& w,
+    PosteriorSums& sums,
+    double& log_likelihood) {
+  const double tiny = std::numeric_limits<double>::min();
+  const std::vector<int64_t>& state_label = w.state_label;
+
+  // Emissions are taken relative to each frame's best class: emit[s] = exp(lp(t, label(s)) - max_c lp(t, c)).
+  std::vector<double>& class_prob = w.class_prob;
+  std::vector<double>& emit = w.emit;
+  class_prob.resize(size_t(C));
+  emit.assign(size_t(S) + 2, 0.0);
+  auto load_emit = [&](int64_t t) -> double {
+    const float* row = log_probs + size_t(t * C);
+    const float best = *std::max_element(row, row + C);
+    for (int64_t c = 0; c < C; ++c) class_prob[size_t(c)] = std::exp(double(row[c]) - best);
+    for (int64_t s = band.start[size_t(t)]; s < band.end[size_t(t)]; ++s) {
+      emit[size_t(s)] = class_prob[size_t(state_label[size_t(s)])];
+    }
+    return double(best);
+  };
+  auto row_max = [](const double* v, int64_t st, int64_t en) {
+    double m = 0.0;
+    for (int64_t s = st; s < en; ++s) m = std::max(m, v[s]);
+    return m;
+  };
+
+  // The scaled alphas of band cells, packed: row t lives at row_off[t] .. row_off[t] + width(t).
+  // Only one of this and log_posteriors()' buffer is held at a time.
+  std::vector<float>().swap(w.log_alpha);
+  std::vector<uint32_t>& alpha = w.alpha;
+  alpha.resize(w.row_off[size_t(T)]);
+
+  // Forward pass. `prev` holds row t-1 over the full state range (zero outside the band);
+  // alpha_scale[t] is the log of the factor taken out of row t.
+  std::vector<double>& prev = w.prev;
+  std::vector<double>& cur = w.cur;
+  prev.assign(size_t(S) + 2, 0.0);
+  cur.assign(size_t(S) + 2, 0.0);
+  // Offset by 2 so s-1 and s-2 never index before the buffer.
+  double* pv = prev.data() + 2;
+  double* cv = cur.data() + 2;
+  const double* sk = w.skip.data();
+  const double* em = emit.data();
+  std::vector<double>& alpha_scale = w.alpha_scale;
+  alpha_scale.resize(size_t(T));
+  double log_scale = 0.0;
+  for (int64_t t = 0; t < T; ++t) {
+    const int64_t st = band.start[size_t(t)];
+    const int64_t en = band.end[size_t(t)];
+    log_scale += load_emit(t);
+    if (t == 0) {
+      for (int64_t s = st; s < en; ++s) cv[s] = em[s];
+    } else {
+      for (int64_t s = st; s < en; ++s) cv[s] = (pv[s] + pv[s - 1] + sk[s] * pv[s - 2]) * em[s];
+      // Clear the previous row's band so `prev` is all zero outside row t after the swap.
+      for (int64_t s = band.start[size_t(t - 1)]; s < band.end[size_t(t - 1)]; ++s) pv[s] = 0.0;
+    }
+    const double m = row_max(cv, st, en);
+    if (m < tiny) return false;
+    log_scale += std::log(m);
+    alpha_scale[size_t(t)] = log_scale;
+    const double inv = 1.0 / m;
+    uint32_t* dst = alpha.data() + w.row_off[size_t(t)];
+    for (int64_t s = st; s < en; ++s) {
+      const double a = cv[s] * inv;
+      cv[s] = a >= tiny ? a : 0.0;  // no denormals
+      dst[s - st] = pack_prob(cv[s]);
+    }
+    std::swap(pv, cv);
+  }
+  const double final_mass = pv[S - 1] + pv[S - 2];
+  if (final_mass < tiny) return false;
+  log_likelihood = log_scale + std::log(final_mass);
+
+  // Backward pass. `next_e[s]` = beta(t+1, s) * emit(t+1, s), zero outside band t+1; beta rows are
+  // rescaled like the alphas. `pv` / `cv` are reused for the alphas of rows t-1 / t, unpacked from
+  // the stored rows; beta_scale is the log of the factor taken out of beta row t.
+  std::fill(prev.begin(), prev.end(), 0.0);
+  std::fill(cur.begin(), cur.end(), 0.0);
+  w.beta.assign(size_t(S) + 2, 0.0);
+  w.next_e.assign(size_t(S) + 2, 0.0);
+  double* beta = w.beta.data();
+  double* next_e = w.next_e.data();
+  auto load_alpha = [&](double* dst, int64_t t) {
+    const int64_t st = band.start[size_t(t)];
+    const uint32_t* src = alpha.data() + w.row_off[size_t(t)];
+    for (int64_t s = st; s < band.end[size_t(t)]; ++s) dst[s] = unpack_prob(src[s - st]);
+  };
+  load_alpha(cv, T - 1);
+  double beta_scale = 0.0;
+  double emit_shift = 0.0;  // load_emit() of frame t+1
+
+  for (int64_t t = T - 1; t >= 0; --t) {
+    const int64_t st = band.start[size_t(t)];
+    const int64_t en = band.end[size_t(t)];
+
+    if (t == T - 1) {
+      for (int64_t s = st; s < en; ++s) beta[s] = (s >= S - 2) ? 1.0 : 0.0;
+    } else {
+      for (int64_t s = st; s < en; ++s) beta[s] = next_e[s] + next_e[s + 1] + sk[s + 2] * next_e[s + 2];
+      const double m = row_max(beta, st, en);
+      if (m < tiny) return false;
+      beta_scale += emit_shift + std::log(m);
+      const double inv = 1.0 / m;
+      for (int64_t s = st; s < en; ++s) {
+        const double b = beta[s] * inv;
+        beta[s] = b >= tiny ? b : 0.0;
+      }
+    }
+    if (t > 0) {
+      if (t + 1 < T) {
+        for (int64_t s = band.start[size_t(t + 1)]; s < band.end[size_t(t + 1)]; ++s) pv[s] = 0.0;
+      }
+      load_alpha(pv, t - 1);
+    }
+
+    // P(state s at frame t) is alpha * beta normalized over the frame. The tolerance is far above
+    // the rounding of the packed alphas and far below anything visible in the posteriors.
+    double mass = 0.0;
+    for (int64_t s = st; s < en; ++s) mass += cv[s] * beta[s];
+    if (mass < tiny) return false;
+    if (std::fabs(alpha_scale[size_t(t)] + beta_scale + std::log(mass) - log_likelihood) > 1e-4) return false;
+    const double norm = 1.0 / mass;
+
+    // Odd states only: the targets. Entry and exit are the share of g that arrives from s-1 / s-2
+    // at t-1 and leaves to s+1 / s+2 at t+1, read off the same sums the recurrences use.
+    for (int64_t s = st | 1; s < en; s += 2) {
+      const double g = cv[s] * beta[s] * norm;
+      if (g == 0.0) continue;
+      const size_t k = size_t(s / 2);
+      sums.occ[k] += g;
+      if (float(g) > sums.peak[k]) sums.peak[k] = float(g);
+
+      // Entry at t: in state s now but not at t-1 (or the path starts here).
+      double enter = g;
+      if (t > 0) {
+        const double from_before = pv[s - 1] + sk[s] * pv[s - 2];
+        const double in = pv[s] + from_before;
+        if (in > 0.0) enter = g * from_before / in;
+      }
+      sums.start_acc[k] += double(t) * enter;
+
+      // Exit after t: in state s now but not at t+1 (or the path ends here).
+      double leave = g;
+      if (t + 1 < T) {
+        const double to_after = next_e[s + 1] + sk[s + 2] * next_e[s + 2];
+        const double out_of = next_e[s] + to_after;
+        if (out_of > 0.0) leave = g * to_after / out_of;
+      }
+      sums.end_acc[k] += double(t) * leave;
+    }
+
+    // Prepare next_e for frame t-1 and clear stale cells.
+    if (t + 1 < T) {
+      for (int64_t s = band.start[size_t(t + 1)]; s < band.end[size_t(t + 1)]; ++s) next_e[s] = 0.0;
+    }
+    if (t > 0) {
+      emit_shift = load_emit(t);
+      for (int64_t s = st; s < en; ++s) next_e[s] = beta[s] * em[s];
+    }
+    for (int64_t s = st; s < en; ++s) beta[s] = 0.0;
+    std::swap(pv, cv);
+  }
+  return true;
+}
+
+// The same sums in the log domain, for inputs whose rows span more than a double's range.
+// Several exps and logs per cell, so only used when scaled_posteriors() gives up.
+void log_posteriors(
+    const float* log_probs,
+    int64_t T,
+    int64_t C,
+    int64_t S,
+    const TrellisBand& band,
+    TrellisWorkspace& w,
+    PosteriorSums& sums,
+    double& log_likelihood) {
+  const float neg_inf = -std::numeric_limits<float>::infinity();
+  const std::vector<int64_t>& state_label = w.state_label;
+  auto skip = [&](int64_t s) { return s < S && w.skip[size_t(s)] != 0.0; };
+
+  // Log-alphas of band cells, laid out like the packed ones (which are released first).
+  std::vector<uint32_t>().swap(w.alpha);
+  std::vector<float>& alpha = w.log_alpha;
+  alpha.assign(w.row_off[size_t(T)], neg_inf);
+  auto alpha_at = [&](int64_t t, int64_t s) -> float {
+    const int64_t st = band.start[size_t(t)];
+    if (s < st || s >= band.end[size_t(t)]) return neg_inf;
+    return alpha[w.row_off[size_t(t)] + size_t(s - st)];
+  };
+
+  // Like the scaled pass, each row is shifted to a maximum of 0 (the shift summed in double), so
+  // the floats hold small numbers instead of ones the size of the total log-likelihood.
+  double log_scale = 0.0;
+  for (int64_t t = 0; t < T; ++t) {
+    const int64_t st = band.start[size_t(t)];
+    const int64_t en = band.end[size_t(t)];
+    const float* row = log_probs + size_t(t * C);
+    float* dst = alpha.data() + w.row_off[size_t(t)];
+    float m = neg_inf;
+    for (int64_t s = st; s < en; ++s) {
+      const float in = t == 0 ? 0.0f
+                              : log_add3(alpha_at(t - 1, s), alpha_at(t - 1, s - 1),
+                                         skip(s) ? alpha_at(t - 1, s - 2) : neg_inf);
+      dst[s - st] = in + row[state_label[size_t(s)]];
+      m = std::max(m, dst[s - st]);
+    }
+    if (m == neg_inf) return;
+    for (int64_t s = st; s < en; ++s) dst[s - st] -= m;
+    log_scale += m;
+  }
+  const float final_mass = log_add(alpha_at(T - 1, S - 1), alpha_at(T - 1, S - 2));
+  if (final_mass == neg_inf) return;
+  log_likelihood = log_scale + final_mass;
+
+  // Backward pass. `next_e[s]` = beta(t+1, s) + log_probs(t+1, label(s)), neg_inf outside band t+1.
+  std::vector<float> beta(size_t(S) + 2, neg_inf);
+  std::vector<float> next_e(size_t(S) + 2, neg_inf);
+  for (int64_t t = T - 1; t >= 0; --t) {
+    const int64_t st = band.start[size_t(t)];
+    const int64_t en = band.end[size_t(t)];
+    const float* row = log_probs + size_t(t * C);
+    float m = neg_inf;
+    for (int64_t s = st; s < en; ++s) {
+      beta[size_t(s)] = t == T - 1 ? (s >= S - 2 ? 0.0f : neg_inf)
+                                   : log_add3(next_e[size_t(s)], next_e[size_t(s) + 1],
+                                              skip(s + 2) ? next_e[size_t(s) + 2] : neg_inf);
+      m = std::max(m, beta[size_t(s)]);
+    }
+    if (m == neg_inf) return;
+    for (int64_t s = st; s < en; ++s) beta[size_t(s)] -= m;
+    float mass = neg_inf;
+    for (int64_t s = st; s < en; ++s) mass = log_add(mass, alpha_at(t, s) + beta[size_t(s)]);
+
+    for (int64_t s = st | 1; s < en; s += 2) {
+      const double g = std::exp(alpha_at(t, s) + beta[size_t(s)] - mass);
+      if (g == 0.0) continue;
+      const size_t k = size_t(s / 2);
+      sums.occ[k] += g;
+      if (float(g) > sums.peak[k]) sums.peak[k] = float(g);
+
+      double enter = g;
+      if (t > 0) {
+        const float from_before = log_add(alpha_at(t - 1, s - 1), skip(s) ? alpha_at(t - 1, s - 2) : neg_inf);
+        enter = g * std::exp(double(from_before) - log_add(alpha_at(t - 1, s), from_before));
+      }
+      sums.start_acc[k] += double(t) * enter;
+
+      double leave = g;
+      if (t + 1 < T) {
+        const float to_after = log_add(next_e[size_t(s) + 1], skip(s + 2) ? next_e[size_t(s) + 2] : neg_inf);
+        leave = g * std::exp(double(to_after) - log_add(next_e[size_t(s)], to_after));
+      }
+      sums.end_acc[k] += double(t) * leave;
+    }
+
+    if (t + 1 < T) {
+      for (int64_t s = band.start[size_t(t + 1)]; s < band.end[size_t(t + 1)]; ++s) next_e[size_t(s)] = neg_inf;
+    }
+    for (int64_t s = st; s < en; ++s) {
+      next_e[size_t(s)] = beta[size_t(s)] + row[state_label[size_t(s)]];
+      beta[size_t(s)] = neg_inf;
+    }
+  }
+}
+
+}  // namespace
+
+void ctc_posteriors(
+    const float* log_probs,
+    int64_t T,
+    int64_t C,
+    const int64_t* targets,
+    int64_t L,
+    int64_t blank,
+    TokenPosteriors& out,
+    TrellisWorkspace* ws) {
+  if (T <= 0 || C <= 0) throw std::runtime_error("invalid log_probs shape");
+  if (L <= 0) throw std::runtime_error("empty targets");
+
+  const int64_t S = 2 * L + 1;
+  const int64_t R = count_repeats(targets, L);
+  if (T < L + R) throw std::runtime_error("targets length is too long for CTC");
+
+  TrellisWorkspace local;
+  TrellisWorkspace& w = ws ? *ws : local;
+  const TrellisBand band = compute_band(T, targets, L, R, w);
+
+  // Per-state label and skip flag (1 where state s may be entered from s-2 over a blank, padded by
+  // two zeros), so the inner loops are branch-free.
+  std::vector<int64_t>& state_label = w.state_label;
+  std::vector<double>& skip = w.skip;
+  state_label.resize(size_t(S));
+  skip.assign(size_t(S) + 2, 0.0);
+  for (int64_t i = 0; i < S; ++i) {
+    state_label[size_t(i)] = (i % 2 == 0) ? blank : targets[i / 2];
+    if (i % 2 != 0 && i != 1 && targets[i / 2] != targets[i / 2 - 1]) skip[size_t(i)] = 1.0;
+  }
+  std::vector<size_t>& row_off = w.row_off;
+  row_off.assign(size_t(T) + 1, 0);
+  for (int64_t t = 0; t < T; ++t) {
+    const int64_t width = std::max<int64_t>(0, band.end[size_t(t)] - band.start[size_t(t)]);
+    row_off[size_t(t) + 1] = row_off[size_t(t)] + size_t(width);
+  }
+
+  out.peak.assign(size_t(L), 0.0f);
+  w.occ.assign(size_t(L), 0.0);
+  w.start_acc.assign(size_t(L), 0.0);
+  w.end_acc.assign(size_t(L), 0.0);
+  PosteriorSums sums{w.occ, w.start_acc, w.end_acc, out.peak};
+  out.log_likelihood = -std::numeric_limits<double>::infinity();
+  if (!scaled_posteriors(log_probs, T, C, S, band, w, sums, out.log_likelihood)) {
+    out.peak.assign(size_t(L), 0.0f);
+    w.occ.assign(size_t(L), 0.0);
+    w.start_acc.assign(size_t(L), 0.0);
+    w.end_acc.assign(size_t(L), 0.0);
+    out.log_likelihood = -std::numeric_limits<double>::infinity();
+    log_posteriors(log_probs, T, C, S, band, w, sums, out.log_likelihood);
+  }
+
+  out.occupancy.assign(size_t(L), 0.0f);
+  out.expected_start.assign(size_t(L), 0.0f);
+  out.expected_end.assign(size_t(L), 0.0f);
+  for (int64_t k = 0; k < L; ++k) {
+    out.occupancy[size_t(k)] = float(w.occ[size_t(k)]);
+    out.expected_start[size_t(k)] = float(w.start_acc[size_t(k)]);
+    out.expected_end[size_t(k)] = float(w.end_acc[size_t(k)]);
+  }
+}
@@ -60,6 +60,24 @@ std::vector<SrtSegment> parse_json_input(const std::string& content) {
     throw std::runtime_error("Invalid JSON: expected array or object");
 }
 
+SrtSegment parse_json_segment_line(const std::string& line, int default_index) {
+    json j = json::parse(line);
+    if (!j.is_object()) {
+        throw std::runtime_error("Invalid JSON line: expected a segment object");
+    }
+    return parse_segment_object(j, default_index);
+}
+
+std::string format_json_segment_line(const SrtSegment& seg) {
+    json seg_obj;
+    seg_obj["index"] = seg.index;
+    seg_obj["start"] = seg.start_sec;
+    seg_obj["end"] = seg.end_sec;
+    seg_obj["text"] = seg.text;
+    if (seg.has_score) seg_obj["score"] = seg.score;
+    return seg_obj.dump();
+}
+
 std::vector<SrtSegment> read_json_input(const std::filesystem::path& path) {
     return parse_json_input(read_all_text(path));
 }
@@ -77,7 +95,7 @@ std::string format_json_output(
         seg_obj["start"] = seg.start_sec;
         seg_obj["end"] = seg.end_sec;
         seg_obj["text"] = seg.text;
-        seg_obj["score"] = seg.score;
+        if (seg.has_score) seg_obj["score"] = seg.score;
         j["segments"].push_back(seg_obj);
     }
 
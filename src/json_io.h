@@ -13,6 +13,12 @@ std::vector<SrtSegment> read_json_input(const std::filesystem::path& path);
 // Parse JSON from string (for stdin support)
 std::vector<SrtSegment> parse_json_input(const std::string& content);
 
+// Parse one JSON-lines record: a single segment object ({"text": ..., optional index/start/end})
+SrtSegment parse_json_segment_line(const std::string& line, int default_index);
+
+// Format one segment as a single-line JSON record (no trailing newline)
+std::string format_json_segment_line(const SrtSegment& segment);
+
 // Write segments to JSON output file
 // Format: {"segments": [...], "metadata": {"count": N, "processing_time": T}}
 void write_json_output(
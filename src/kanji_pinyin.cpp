@@ -1,95 +1,144 @@
 #include "kanji_pinyin.h"
+#include "mmap_file.h"
 #include "utf8_utils.h"
 
-#include <fstream>
-#include <sstream>
-#include <unordered_map>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
 
 namespace kanji {
 
 namespace {
 
-// Global pinyin lookup table
-std::unordered_map<std::string, std::string> g_pinyin_table;
-bool g_loaded = false;
-
-// Check if a code point is in CJK Unified Ideographs range
-bool is_cjk_codepoint(uint32_t cp) {
-    // CJK Unified Ideographs: U+4E00 to U+9FFF
-    // CJK Extension A: U+3400 to U+4DBF
-    // CJK Extension B-F and other ranges
-    return (cp >= 0x4E00 && cp <= 0x9FFF) ||
-           (cp >= 0x3400 && cp <= 0x4DBF) ||
-           (cp >= 0x20000 && cp <= 0x2A6DF) ||
-           (cp >= 0x2A700 && cp <= 0x2B73F) ||
-           (cp >= 0x2B740 && cp <= 0x2B81F) ||
-           (cp >= 0x2B820 && cp <= 0x2CEAF) ||
-           (cp >= 0xF900 && cp <= 0xFAFF);  // CJK Compatibility Ideographs
+// CJK ranges covered by the table, in the order their slots are laid out.
+struct CjkRange {
+    uint32_t first;
+    uint32_t last;  // inclusive
+};
+
+constexpr CjkRange kCjkRanges[] = {
+    {0x4E00, 0x9FFF},    // CJK Unified Ideographs
+    {0x3400, 0x4DBF},    // CJK Extension A
+    {0x20000, 0x2A6DF},  // CJK Extension B
+    {0x2A700, 0x2B73F},  // CJK Extension C
+    {0x2B740, 0x2B81F},  // CJK Extension D
+    {0x2B820, 0x2CEAF},  // CJK Extension E-F
+    {0xF900, 0xFAFF},    // CJK Compatibility Ideographs
+};
+
+constexpr size_t count_cjk_slots() {
+    size_t n = 0;
+    for (const CjkRange& r : kCjkRanges) n += r.last - r.first + 1;
+    return n;
 }
 
-}  // anonymous namespace
+constexpr size_t kNumSlots = count_cjk_slots();
 
-bool load_pinyin_table(const std::string& data_path) {
-    std::ifstream file(data_path);
-    if (!file.is_open()) {
-        return false;
+// Dense slot of a CJK codepoint, or -1 if it is outside the table ranges.
+int64_t cjk_slot(uint32_t cp) {
+    size_t base = 0;
+    for (const CjkRange& r : kCjkRanges) {
+        if (cp >= r.first && cp <= r.last) return int64_t(base + (cp - r.first));
+        base += r.last - r.first + 1;
     }
+    return -1;
+}
 
-    g_pinyin_table.clear();
-    std::string line;
-
-    while (std::getline(file, line)) {
-        // Skip empty lines
-        if (line.empty()) continue;
+// Check if a code point is in CJK Unified Ideographs range
+bool is_cjk_codepoint(uint32_t cp) {
+    return cjk_slot(cp) >= 0;
+}
 
-        // Find tab separator
-        size_t tab_pos = line.find('\t');
-        if (tab_pos == std::string::npos || tab_pos == 0) continue;
+// The table file is mapped as-is and doubles as the string pool: each slot holds the
+// offset/length of its reading inside the mapping (length 0 = no entry). The slot index
+// is built on the first lookup, so runs that never meet a CJK character only pay for the
+// mmap call.
+struct PinyinTable {
+    MappedFile file;
+    std::once_flag indexed;
+    std::vector<uint32_t> offset;
+    std::vector<uint16_t> length;
+
+    void build_index() {
+        offset.assign(kNumSlots, 0);
+        length.assign(kNumSlots, 0);
+        const char* p = file.data();
+        const char* const end = p + file.size();
+        while (p < end) {
+            const char* eol = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+            if (!eol) eol = end;
+            const std::string_view line(p, size_t(eol - p));
+            p = eol + 1;
+
+            // "<char>\t<pinyin>[ <more readings>]"; the first reading is used.
+            const size_t tab_pos = line.find('\t');
+            if (tab_pos == std::string_view::npos || tab_pos == 0) continue;
+            const std::string_view character = line.substr(0, tab_pos);
+            if (utf8::char_len(static_cast<unsigned char>(character[0])) != character.size()) continue;
+            const int64_t slot = cjk_slot(utf8::to_codepoint(character));
+            if (slot < 0) continue;
+
+            std::string_view pinyin = line.substr(tab_pos + 1);
+            const size_t space_pos = pinyin.find(' ');
+            if (space_pos != std::string_view::npos) pinyin = pinyin.substr(0, space_pos);
+            while (!pinyin.empty() && (pinyin.back() == ' ' || pinyin.back() == '\r')) pinyin.remove_suffix(1);
+            if (pinyin.empty() || pinyin.size() > 0xFFFF) continue;
+
+            // Later lines override earlier ones.
+            offset[size_t(slot)] = uint32_t(pinyin.data() - file.data());
+            length[size_t(slot)] = uint16_t(pinyin.size());
+        }
+    }
 
-        // Extract character (before tab) and pinyin (after tab)
-        std::string character = line.substr(0, tab_pos);
-        std::string pinyin = line.substr(tab_pos + 1);
+    std::string_view lookup(int64_t slot) {
+        std::call_once(indexed, [this] { build_index(); });
+        return std::string_view(file.data() + offset[size_t(slot)], length[size_t(slot)]);
+    }
+};
 
-        // If there are multiple readings separated by space, use first one
-        size_t space_pos = pinyin.find(' ');
-        if (space_pos != std::string::npos) {
-            pinyin = pinyin.substr(0, space_pos);
-        }
+std::unique_ptr<PinyinTable> g_table;
 
-        // Trim trailing whitespace from pinyin
-        while (!pinyin.empty() && (pinyin.back() == ' ' || pinyin.back() == '\r' || pinyin.back() == '\n')) {
-            pinyin.pop_back();
-        }
+}  // anonymous namespace
 
-        if (!character.empty() && !pinyin.empty()) {
-            g_pinyin_table[character] = pinyin;
-        }
+bool load_pinyin_table(const std::string& data_path) {
+    auto table = std::make_unique<PinyinTable>();
+    try {
+        table->file = MappedFile(std::filesystem::path(data_path));
+    } catch (const std::exception&) {
+        return false;
     }
-
-    g_loaded = !g_pinyin_table.empty();
-    return g_loaded;
+    // Entries are indexed lazily; reject files that cannot hold any.
+    if (table->file.empty() || table->file.size() > 0xFFFFFFFFull ||
+        !std::memchr(table->file.data(), '\t', table->file.size())) {
+        return false;
+    }
+    g_table = std::move(table);
+    return true;
 }
 
 bool is_loaded() {
-    return g_loaded;
+    return g_table != nullptr;
 }
 
-std::string kanji_to_pinyin(std::string_view kanji_char) {
-    if (!g_loaded || kanji_char.empty()) {
-        return "";
+std::string_view kanji_to_pinyin(std::string_view kanji_char) {
+    if (!g_table || kanji_char.empty()) {
+        return {};
     }
-
-    std::string key(kanji_char);
-    auto it = g_pinyin_table.find(key);
-    if (it != g_pinyin_table.end()) {
-        return it->second;
+    if (utf8::char_len(static_cast<unsigned char>(kanji_char[0])) != kanji_char.size()) {
+        return {};
+    }
+    const int64_t slot = cjk_slot(utf8::to_codepoint(kanji_char));
+    if (slot < 0) {
+        return {};
     }
-    return "";
+    return g_table->lookup(slot);
 }
 
 std::string romanize_kanji(const std::string& text) {
-    if (!g_loaded) {
+    if (!g_table) {
         return text;  // Return unchanged if table not loaded
     }
 
@@ -113,7 +162,7 @@ std::string romanize_kanji(const std::string& text) {
 
         // Check if it's a CJK character
         if (is_cjk_codepoint(cp)) {
-            std::string pinyin = kanji_to_pinyin(char_view);
+            std::string_view pinyin = kanji_to_pinyin(char_view);
             if (!pinyin.empty()) {
                 result += pinyin;
             } else {
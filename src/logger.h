@@ -3,6 +3,7 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <string>
 
 class Logger {
@@ -20,6 +21,7 @@ class Logger {
   void log(Level level, const std::string& msg) {
     if (level == Level::Debug && !debug_enabled_) return;
     const std::string line = format(level, msg);
+    std::lock_guard<std::mutex> lock(mutex_);  // startup steps log from worker threads
     std::cerr << line;
     if (file_.is_open()) file_ << line;
   }
@@ -58,5 +60,6 @@ class Logger {
 
   bool debug_enabled_ = false;
   std::ofstream file_;
+  std::mutex mutex_;
 };
 
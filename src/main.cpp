@@ -4,9 +4,13 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <numeric>
 #include <sstream>
 #include <stdexcept>
@@ -15,41 +19,25 @@
 #include <vector>
 
 namespace fs = std::filesystem;
+#include "batch_align.h"
 #include "cli_args.h"
 #include "emissions.h"
-#include "forced_align.h"
 #include "json_io.h"
 #include "logger.h"
 #include "model_config.h"
-#include "postprocess.h"
-#include "span_align.h"
 #include "srt_io.h"
 #include "text_preprocess.h"
 #include "vocab.h"
 #include "vocab_json.h"
 #include "audio_decode.h"
 #include "kanji_pinyin.h"
+#include "manifest.h"
+#include "serve.h"
 #include "stacktrace.h"
-#include "utf8_utils.h"
+#include "stream_align.h"
 
 // Emissions generation now lives in emissions.cpp; keep main minimal.
 
-// ---------------------------------------------------------------------------
-// Sub-batch alignment: handles CTC "targets too long" by recursive splitting
-// ---------------------------------------------------------------------------
-static void align_and_map_batch(
-    std::vector<SrtSegment>& segs,
-    const float* all_log_probs,  // full emissions buffer
-    int64_t frame_off,           // first frame index for this batch
-    int64_t frame_cnt,           // number of frames for this batch
-    int64_t classes,
-    int stride_ms,
-    const Vocab& vocab,
-    const PreprocessConfig& prep_config,
-    const ModelConfig& model_config,
-    Logger& log,
-    int depth = 0);
-
 // Forward declaration
 static int run_alignment(int argc, char** argv);
 
@@ -72,207 +60,389 @@ int main(int argc, char** argv) {
 }
 
 // ---------------------------------------------------------------------------
-// align_and_map_batch implementation
+// ORT session setup shared by batch and streaming modes
 // ---------------------------------------------------------------------------
-static void align_and_map_batch(
-    std::vector<SrtSegment>& segs,
-    const float* all_log_probs,
-    int64_t frame_off,
-    int64_t frame_cnt,
-    int64_t classes,
-    int stride_ms,
-    const Vocab& vocab,
-    const PreprocessConfig& prep_config,
-    const ModelConfig& model_config,
-    Logger& log,
-    int depth) {
-  if (segs.empty() || frame_cnt <= 0) return;
-
-  // 1. Build full_text from this batch's segments
-  std::string full_text;
-  for (size_t i = 0; i < segs.size(); ++i) {
-    std::string seg_text = segs[i].text;
-    for (char& ch : seg_text) { if (ch == '\n') ch = ' '; }
-    while (!seg_text.empty() && std::isspace(static_cast<unsigned char>(seg_text.front()))) seg_text.erase(seg_text.begin());
-    while (!seg_text.empty() && std::isspace(static_cast<unsigned char>(seg_text.back()))) seg_text.pop_back();
-    if (i) full_text.push_back(' ');
-    full_text += seg_text;
-  }
-
-  // 2. Preprocess and tokenize
-  const auto prep = preprocess_text(full_text, vocab, prep_config);
-  const auto& tokens_starred = prep.tokens_starred;
-  const auto& text_starred = prep.text_starred;
-
-  // 3. Build targets
-  const int64_t star_id = vocab.star_id;
-  std::vector<int64_t> targets;
-  targets.reserve(2000);
-  std::string joined;
-  for (const auto& t : tokens_starred) {
-    if (!joined.empty()) joined.push_back(' ');
-    joined += t;
-  }
-  size_t pos = 0;
-  while (pos < joined.size()) {
-    size_t next = joined.find(' ', pos);
-    if (next == std::string::npos) next = joined.size();
-    const auto piece = joined.substr(pos, next - pos);
-    if (!piece.empty()) {
-      if (piece == "<star>") {
-        targets.push_back(star_id);
-      } else {
-        auto it = vocab.token_to_id.find(piece);
-        if (it != vocab.token_to_id.end()) targets.push_back(it->second);
-      }
-    }
-    pos = next + 1;
+static Ort::Session create_session(Ort::Env& env, const fs::path& model_onnx, int threads, Logger& log) {
+  Ort::SessionOptions opts;
+  int num_threads = threads;
+  if (num_threads <= 0) {
+    num_threads = static_cast<int>(std::thread::hardware_concurrency());
+    if (num_threads <= 0) num_threads = 4;
+    num_threads = std::max(4, (num_threads + 1) / 2);
   }
-
-  // 4. Check CTC constraint: T >= L + R
-  const int64_t T = frame_cnt;
-  const int64_t L = int64_t(targets.size());
-  int64_t R = 0;
-  for (int64_t i = 1; i < L; ++i) {
-    if (targets[i] == targets[i - 1]) ++R;
+  opts.SetIntraOpNumThreads(num_threads);
+  opts.SetInterOpNumThreads(1);  // Keep inter-op at 1 for better cache locality
+  opts.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+  {
+    std::ostringstream ss;
+    ss << "ORT threads: " << num_threads << ", graph optimization: ALL";
+    log.info(ss.str());
   }
 
-  if (T < L + R) {
-    // Need to split — can't fit all targets in available frames
-    if (segs.size() <= 1 || frame_cnt < 2) {
-      // Can't split further — skip alignment, keep original timestamps
-      log.info("[sub-batch] Cannot split further for CTC, skipping alignment");
-      return;
-    }
-
-    const size_t mid = segs.size() / 2;
+  // Model path comes from config (supports both model.onnx and model.int8.onnx)
+#ifdef _WIN32
+  return Ort::Session(env, model_onnx.wstring().c_str(), opts);
+#else
+  return Ort::Session(env, model_onnx.string().c_str(), opts);
+#endif
+}
 
-    // Determine frame split point from segment timestamps
-    const double t_end_first = segs[mid - 1].end_sec;
-    const double t_start_second = segs[mid].start_sec;
-    const double split_time = (t_end_first + t_start_second) / 2.0;
-    int64_t split_frame = static_cast<int64_t>(split_time * 1000.0 / stride_ms) - frame_off;
-    split_frame = std::max<int64_t>(1, std::min<int64_t>(split_frame, frame_cnt - 1));
+// ---------------------------------------------------------------------------
+// Input/output helpers shared by whole-file and long-form modes
+// ---------------------------------------------------------------------------
+static std::vector<SrtSegment> read_input_segments(const CliArgs& args, Logger& log) {
+  std::vector<SrtSegment> srt_segments;
 
+  // Read segments from JSON or SRT input
+  if (!args.json_input.empty()) {
+    if (args.json_input.string() == "-") {
+      // Read from stdin
+      std::ostringstream ss;
+      ss << std::cin.rdbuf();
+      srt_segments = parse_json_input(ss.str());
+    } else {
+      srt_segments = read_json_input(args.json_input);
+    }
     {
       std::ostringstream ss;
-      ss << "[sub-batch depth=" << depth << "] Splitting " << segs.size()
-         << " segments (T=" << T << " < L+R=" << (L + R)
-         << ") at seg " << mid << ", frame " << split_frame;
+      ss << "Read " << srt_segments.size() << " segments from JSON input";
       log.info(ss.str());
     }
+  } else {
+    srt_segments = read_srt_utf8(args.srt);
+  }
+  return srt_segments;
+}
 
-    std::vector<SrtSegment> first_half(segs.begin(), segs.begin() + mid);
-    std::vector<SrtSegment> second_half(segs.begin() + mid, segs.end());
-
-    align_and_map_batch(first_half, all_log_probs, frame_off, split_frame,
-                        classes, stride_ms, vocab, prep_config, model_config, log, depth + 1);
-    align_and_map_batch(second_half, all_log_probs, frame_off + split_frame,
-                        frame_cnt - split_frame, classes, stride_ms, vocab, prep_config,
-                        model_config, log, depth + 1);
+static Vocab load_model_vocab(const fs::path& model_dir, Logger& log) {
+  auto vocab = load_vocab(model_dir);
+  {
+    std::ostringstream ss;
+    ss << "Loaded vocab: " << vocab.vocab_size() << " tokens (format: "
+       << (vocab.format == VocabFormat::JSON ? "JSON" : "TXT") << ")";
+    log.info(ss.str());
+  }
+  return vocab;
+}
 
-    // Merge results back
-    for (size_t i = 0; i < mid; ++i) segs[i] = first_half[i];
-    for (size_t i = 0; i < second_half.size(); ++i) segs[mid + i] = second_half[i];
-    return;
+static void check_vocab_matches(const Vocab& vocab, int64_t classes) {
+  if (vocab.star_id != classes - 1) {
+    throw std::runtime_error(
+        "vocab size mismatch: emissions classes=" + std::to_string(classes) + ", vocab+star=" +
+        std::to_string(vocab.star_id + 1) + " (check matching model + vocab file)");
   }
+}
 
-  // 5. Run forced alignment on the emission slice
-  const float* slice_ptr = all_log_probs + frame_off * classes;
-  std::vector<int64_t> path;
-  std::vector<float> scores;
-  forced_align(slice_ptr, T, classes, targets.data(), L, /*blank=*/0, path, scores);
+// Checks the vocab against the model's declared output width, when it has a fixed one, so a
+// mismatched vocab fails before inference instead of after it.
+static void check_model_vocab(Ort::Session& session, const Vocab& vocab) {
+  const auto shape = session.GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+  if (!shape.empty() && shape.back() > 0) check_vocab_matches(vocab, shape.back() + 1);
+}
 
-  // 6. Post-process: merge repeats → spans → word timestamps
-  std::unordered_map<int64_t, std::string> idx_to_token;
-  for (const auto& kv : vocab.token_to_id) idx_to_token[kv.second] = kv.first;
-  idx_to_token[star_id] = "<star>";
+static void write_alignment_outputs(
+    const CliArgs& args,
+    const std::vector<SrtSegment>& srt_segments,
+    const std::vector<SrtSegment>& original_segments_for_debug,
+    bool romanize,
+    double audio_duration,
+    Logger& log) {
+  // Write output in JSON or SRT format
+  if (!args.json_output.empty()) {
+    if (args.json_output.string() == "-") {
+      std::cout << format_json_output(srt_segments, 0.0);
+    } else {
+      write_json_output(args.json_output, srt_segments, 0.0);
+      log.info(std::string("Wrote aligned JSON: ") + args.json_output.string());
+    }
+  } else {
+    write_srt_utf8(args.output, srt_segments);
+    log.info(std::string("Wrote aligned SRT: ") + args.output.string());
+  }
 
-  const auto merged = merge_repeats_str(path, idx_to_token);
-  const std::string blank_token = (model_config.type == ModelType::MMS_300M) ? "<blank>" : "<s>";
-  const auto spans = get_spans_str(tokens_starred, merged, blank_token);
-  auto word_ts = postprocess_results(text_starred, spans, stride_ms, scores);
+  if (args.debug && !args.debug_dir.empty()) {
+    fs::create_directories(args.debug_dir);
+    using json = nlohmann::json;
 
-  // Apply time offset for this slice
-  const double time_offset = double(frame_off) * double(stride_ms) / 1000.0;
-  for (auto& w : word_ts) {
-    w.start_sec += time_offset;
-    w.end_sec += time_offset;
+    // 01_original_segments.json
+    {
+      json j = json::array();
+      for (size_t i = 0; i < original_segments_for_debug.size(); ++i) {
+        const auto& seg = original_segments_for_debug[i];
+        j.push_back({{"index", i + 1}, {"start", seg.start_sec}, {"end", seg.end_sec},
+                      {"text", seg.text}, {"score", seg.score}});
+      }
+      std::ofstream f(args.debug_dir / "01_original_segments.json", std::ios::binary);
+      f << j.dump(2) << "\n";
+    }
+    // 06_aligned_segments.json
+    {
+      json j = json::array();
+      for (size_t i = 0; i < srt_segments.size(); ++i) {
+        const auto& seg = srt_segments[i];
+        j.push_back({{"index", i + 1}, {"start", seg.start_sec}, {"end", seg.end_sec}, {"text", seg.text}});
+        if (seg.has_score) j.back()["score"] = seg.score;
+      }
+      std::ofstream f(args.debug_dir / "06_aligned_segments.json", std::ios::binary);
+      f << j.dump(2) << "\n";
+    }
+    // 00_summary.json
+    {
+      json j = {
+        {"audio_path", args.audio.string()},
+        {"srt_path", args.srt.string()},
+        {"language", args.language},
+        {"romanize", romanize},
+        {"audio_duration", audio_duration >= 0.0 ? json(audio_duration) : json(nullptr)},
+        {"num_segments", srt_segments.size()},
+        {"processing_time", 0.0}
+      };
+      std::ofstream f(args.debug_dir / "00_summary.json", std::ios::binary);
+      f << j.dump(2) << "\n";
+    }
   }
+}
 
-  // 7. Map word timestamps back to SRT segments
-  const float log_vocab = std::log(static_cast<float>(vocab.vocab_size()));
-  size_t char_idx = 0;
+// Aligns `segs` against `audio`, a clip starting at `start_sample` of the recording: emissions
+// cover only the clip, alignment runs in clip-local time and the timestamps are shifted back to
+// absolute time. `label` prefixes the log line.
+static void align_clip(
+    std::vector<SrtSegment>& segs,
+    const std::vector<float>& audio,
+    int64_t start_sample,
+    const std::string& label,
+    Ort::Session& session,
+    int batch_size,
+    const Vocab& vocab,
+    const PreprocessConfig& prep_config,
+    const ModelConfig& model_config,
+    bool posterior_confidence,
+    Logger& log) {
+  constexpr int64_t kSampleRate = 16000;
+  const auto emissions = generate_emissions_ort(
+      session, audio, /*window_seconds=*/30, /*context_seconds=*/2, /*batch_size=*/batch_size,
+      /*star_logp=*/0.0f);
+  check_vocab_matches(vocab, emissions.classes);
+  {
+    std::ostringstream ss;
+    ss << label << ", audio " << (double(start_sample) / kSampleRate) << "-"
+       << (double(start_sample + int64_t(audio.size())) / kSampleRate) << " s, " << emissions.frames << " frames";
+    log.info(ss.str());
+  }
+
+  const double offset = double(start_sample) / double(kSampleRate);
   for (auto& seg : segs) {
-    std::string seg_text = seg.text;
-    for (char& ch : seg_text) { if (ch == '\n') ch = ' '; }
-    while (!seg_text.empty() && std::isspace(static_cast<unsigned char>(seg_text.front()))) seg_text.erase(seg_text.begin());
-    while (!seg_text.empty() && std::isspace(static_cast<unsigned char>(seg_text.back()))) seg_text.pop_back();
-
-    const size_t num_chars = utf8::codepoint_count(seg_text);
-    if (num_chars == 0 || char_idx >= word_ts.size()) continue;
-
-    if (char_idx > 0 && char_idx < word_ts.size()) {
-      std::string t = word_ts[char_idx].text;
-      size_t l = 0;
-      while (l < t.size() && std::isspace(static_cast<unsigned char>(t[l]))) l++;
-      size_t r2 = t.size();
-      while (r2 > l && std::isspace(static_cast<unsigned char>(t[r2 - 1]))) r2--;
-      if (r2 <= l) char_idx += 1;
+    seg.start_sec -= offset;
+    seg.end_sec -= offset;
+  }
+  align_segments(segs, emissions.log_probs.data(), emissions.frames, emissions.classes, emissions.stride_ms,
+                 vocab, prep_config, model_config, posterior_confidence, /*threads=*/0, log);
+  for (auto& seg : segs) {
+    seg.start_sec += offset;
+    seg.end_sec += offset;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Long-form alignment: decode, infer and align one section of segments at a time
+// ---------------------------------------------------------------------------
+// Consecutive segments are grouped into sections of about section_seconds, cut at the middle
+// of the gap between two segments (as sub-batch splitting does). Each section's audio is
+// decoded on its own, padded by kSectionMargin on each side to absorb subtitle timing error,
+// and its waveform and emissions are released once its segments are mapped. Memory is bounded
+// by the section length rather than the recording length. Returns the audio duration (s).
+static double align_long_form(
+    std::vector<SrtSegment>& segs,
+    const fs::path& audio_path,
+    const AudioInput& audio_input,
+    double section_seconds,
+    Ort::Session& session,
+    int batch_size,
+    const Vocab& vocab,
+    const PreprocessConfig& prep_config,
+    const ModelConfig& model_config,
+    bool posterior_confidence,
+    Logger& log) {
+  constexpr double kSectionMargin = 10.0;
+  constexpr int64_t kSampleRate = 16000;
+
+  bool timed = false;
+  for (const auto& seg : segs) timed = timed || seg.end_sec > 0.0;
+  if (!segs.empty() && !timed) {
+    throw std::runtime_error("--long-form needs segment timestamps to place sections (SRT or JSON start/end)");
+  }
+
+  AudioReader reader(audio_path, audio_input);
+  const int64_t total_samples = reader.length_samples();
+  {
+    std::ostringstream ss;
+    ss << "Long-form mode: " << (total_samples >= 0 ? std::to_string(total_samples) : std::string("unknown"))
+       << " samples, sections of ~" << section_seconds << " s";
+    log.info(ss.str());
+  }
+
+  int64_t audio_end = 0;
+  double prev_cut = 0.0;
+  size_t section = 0;
+  for (size_t i = 0; i < segs.size(); ++section) {
+    // Take segments while the section stays within section_seconds (always at least one).
+    double first_start = segs[i].start_sec;
+    double last_end = segs[i].end_sec;
+    size_t j = i + 1;
+    while (j < segs.size() && segs[j].end_sec - first_start <= section_seconds) {
+      first_start = std::min(first_start, segs[j].start_sec);
+      last_end = std::max(last_end, segs[j].end_sec);
+      ++j;
     }
-    if (char_idx >= word_ts.size()) continue;
-
-    const size_t start_idx = char_idx;
-    seg.start_sec = word_ts[char_idx].start_sec;
-    const size_t end_idx = std::min(char_idx + num_chars - 1, word_ts.size() - 1);
-    seg.end_sec = word_ts[end_idx].end_sec;
-
-    // Confidence score
-    auto has_content_char = [&vocab](const std::string& s) {
-      const auto chars = utf8::split_chars(s);
-      for (const auto& ch : chars) {
-        if (vocab.token_to_id.count(ch)) return true;
-        if (ch.size() == 1 && ch[0] >= 'A' && ch[0] <= 'Z') {
-          std::string lower(1, static_cast<char>(ch[0] - 'A' + 'a'));
-          if (vocab.token_to_id.count(lower)) return true;
-        }
-      }
-      for (const auto& ch : chars) {
-        if (ch.size() == 1) {
-          char c = ch[0];
-          if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) return true;
-          continue;
-        }
-        uint32_t cp = utf8::to_codepoint(std::string_view(ch.data(), ch.size()));
-        if ((cp >= 0x2000 && cp <= 0x206F) || (cp >= 0x3000 && cp <= 0x303F) ||
-            (cp >= 0xFE30 && cp <= 0xFE6F) || (cp >= 0xFF01 && cp <= 0xFF0F) ||
-            (cp >= 0xFF1A && cp <= 0xFF20) || (cp >= 0xFF3B && cp <= 0xFF40) ||
-            (cp >= 0xFF5B && cp <= 0xFF65))
-          continue;
-        return true;
+    double next_cut = std::numeric_limits<double>::infinity();
+    if (j < segs.size()) next_cut = std::max(prev_cut, (segs[j - 1].end_sec + segs[j].start_sec) / 2.0);
+
+    const double t0 = std::max(prev_cut, first_start - kSectionMargin);
+    const double t1 = std::max(t0, std::min(next_cut, last_end + kSectionMargin));
+    int64_t start_sample = static_cast<int64_t>(t0 * kSampleRate);
+    int64_t end_sample = static_cast<int64_t>(std::ceil(t1 * kSampleRate));
+    if (total_samples >= 0) {
+      start_sample = std::min(start_sample, total_samples);
+      end_sample = std::min(end_sample, total_samples);
+    }
+
+    std::vector<SrtSegment> part(segs.begin() + std::ptrdiff_t(i), segs.begin() + std::ptrdiff_t(j));
+    const auto audio = reader.read(start_sample, end_sample - start_sample);
+    if (!audio.empty()) {
+      audio_end = std::max(audio_end, start_sample + int64_t(audio.size()));
+      std::ostringstream label;
+      label << "[section " << section << "] segments " << i << "-" << (j - 1);
+      align_clip(part, audio, start_sample, label.str(), session, batch_size, vocab, prep_config, model_config,
+                 posterior_confidence, log);
+      for (size_t k = 0; k < part.size(); ++k) {
+        segs[i + k].start_sec = part[k].start_sec;
+        segs[i + k].end_sec = part[k].end_sec;
+        segs[i + k].score = part[k].score;
       }
-      return false;
-    };
-    std::vector<float> token_probs;
-    token_probs.reserve(end_idx - start_idx + 1);
-    for (size_t wi = start_idx; wi <= end_idx && wi < word_ts.size(); ++wi) {
-      const auto& wt = word_ts[wi];
-      if (!has_content_char(wt.text)) continue;
-      float tlp = wt.score;
-      if (tlp >= 0.0f) { token_probs.push_back(0.0f); continue; }
-      float dur = static_cast<float>(wt.end_sec - wt.start_sec);
-      int nf = std::max(1, static_cast<int>(dur / 0.02f));
-      float avg = tlp / static_cast<float>(nf);
-      token_probs.push_back(std::max(0.0f, std::min(1.0f, 1.0f + avg / log_vocab)));
+    } else {
+      for (size_t k = i; k < j; ++k) segs[k].has_score = false;
+      std::ostringstream ss;
+      ss << "[section " << section << "] segments " << i << "-" << (j - 1)
+         << " start past the end of the audio, keeping original timestamps";
+      log.warn(ss.str());
     }
-    if (!token_probs.empty()) {
-      float sum = 0.0f;
-      for (float p : token_probs) sum += p;
-      seg.score = sum / static_cast<float>(token_probs.size());
+
+    prev_cut = std::isfinite(next_cut) ? next_cut : t1;
+    i = j;
+  }
+
+  return double(total_samples >= 0 ? total_samples : audio_end) / double(kSampleRate);
+}
+
+// ---------------------------------------------------------------------------
+// Range alignment: decode, infer and align one time range of the recording
+// ---------------------------------------------------------------------------
+// Only [range_start, range_end) is decoded (the reader seeks straight to it) and run through
+// the model. With --segment-range the range is the segments' span padded by kRangeMargin and
+// every segment is aligned; otherwise only segments lying inside the range are (all of them if
+// the input has no timestamps) and the rest are written back as read, without a score. Fails if
+// the range starts past the end of the audio. Returns the recording's duration (s), or -1 if the
+// decoder cannot report it.
+static double align_range(
+    std::vector<SrtSegment>& segs,
+    const CliArgs& args,
+    const AudioInput& audio_input,
+    Ort::Session& session,
+    int batch_size,
+    const Vocab& vocab,
+    const PreprocessConfig& prep_config,
+    const ModelConfig& model_config,
+    bool posterior_confidence,
+    Logger& log) {
+  constexpr double kRangeMargin = 10.0;  // as for long-form sections
+  constexpr int64_t kSampleRate = 16000;
+
+  bool timed = false;
+  for (const auto& seg : segs) timed = timed || seg.end_sec > 0.0;
+
+  double t0 = std::max(0.0, args.range_start);
+  double t1 = args.range_end;  // < 0: end of the audio
+  if (args.segment_range) {
+    if (!timed) throw std::runtime_error("--segment-range needs segment timestamps (SRT or JSON start/end)");
+    t0 = std::numeric_limits<double>::infinity();
+    t1 = 0.0;
+    for (const auto& seg : segs) {
+      t0 = std::min(t0, seg.start_sec);
+      t1 = std::max(t1, seg.end_sec);
+    }
+    t0 = std::max(0.0, t0 - kRangeMargin);
+    t1 += kRangeMargin;
+  }
+
+  std::vector<size_t> selected;
+  for (size_t i = 0; i < segs.size(); ++i) {
+    const bool inside = segs[i].start_sec >= t0 && (t1 < 0.0 || segs[i].end_sec <= t1);
+    if (!timed || args.segment_range || inside) {
+      selected.push_back(i);
     } else {
-      seg.score = 0.0f;
+      segs[i].has_score = false;
     }
-    char_idx = end_idx + 1;
+  }
+
+  AudioReader reader(args.audio, audio_input);
+  const int64_t total_samples = reader.length_samples();
+  int64_t start_sample = static_cast<int64_t>(t0 * kSampleRate);
+  int64_t end_sample = t1 >= 0.0 ? static_cast<int64_t>(std::ceil(t1 * kSampleRate))
+                                 : std::numeric_limits<int64_t>::max();
+  const double duration = total_samples >= 0 ? double(total_samples) / double(kSampleRate) : -1.0;
+  auto past_end = [&] {
+    std::ostringstream ss;
+    ss << "Range start " << t0 << " s is past the end of the audio";
+    if (duration >= 0.0) ss << " (" << duration << " s)";
+    return std::runtime_error(ss.str());
+  };
+  if (total_samples >= 0) {
+    if (start_sample >= total_samples) throw past_end();
+    end_sample = std::min(end_sample, total_samples);
+  }
+  {
+    std::ostringstream ss;
+    ss << "Range mode: " << t0 << "-" << (t1 >= 0.0 ? std::to_string(t1) : std::string("end")) << " s, "
+       << selected.size() << " of " << segs.size() << " segments inside";
+    log.info(ss.str());
+  }
+  if (selected.empty()) {
+    log.warn("No segments lie inside the range; writing them back unchanged");
+    return duration;
+  }
+
+  const auto audio = reader.read(start_sample, end_sample - start_sample);
+  if (audio.empty()) throw past_end();
+
+  std::vector<SrtSegment> part;
+  part.reserve(selected.size());
+  for (size_t i : selected) part.push_back(segs[i]);
+  align_clip(part, audio, start_sample, "[range]", session, batch_size, vocab, prep_config, model_config,
+             posterior_confidence, log);
+  for (size_t k = 0; k < part.size(); ++k) {
+    SrtSegment& seg = segs[selected[k]];
+    seg.start_sec = part[k].start_sec;
+    seg.end_sec = part[k].end_sec;
+    seg.score = part[k].score;
+  }
+  return duration;
+}
+
+// CPP_ORT_ALIGNER_PROFILE: romanization memo and alignment workspace counters for the whole run.
+static void print_profile(bool romanize) {
+  if (std::getenv("CPP_ORT_ALIGNER_PROFILE") == nullptr) return;
+  if (romanize) {
+    const auto st = romanize_cache_stats();
+    const uint64_t lookups = st.hits + st.misses;
+    std::cerr << "[profile] romanize cache: hits=" << st.hits << " misses=" << st.misses << " hit_rate="
+              << (lookups ? 100.0 * double(st.hits) / double(lookups) : 0.0) << "% entries=" << st.entries
+              << " evictions=" << st.evictions << "\n";
+  }
+  const auto ws = align_workspace_stats();
+  if (ws.jobs > 0) {
+    std::cerr << "[profile] align workspaces: jobs=" << ws.jobs << " workspaces=" << ws.workspaces
+              << " peak_bytes=" << ws.peak_bytes << " peak_total_bytes=" << ws.peak_total_bytes
+              << " retained_bytes=" << ws.retained_bytes << "\n";
   }
 }
 
@@ -304,164 +474,190 @@ static int run_alignment(int argc, char** argv) {
   // - Omnilingual models do NOT need romanization (native CJK support)
   const bool romanize = model_config.requires_romanization && args.romanize;
 
-  // Load kanji pinyin table only if using romanization (MMS model)
+  // Startup steps run concurrently: the ORT session and (for romanization) the kanji pinyin table
+  // load on worker threads, while this thread reads the subtitles and vocab and decodes audio.
+  // Subtitle and vocab problems therefore fail before the session is waited on, let alone used.
+  Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "cpp-ort-aligner");
+  auto session_future = std::async(std::launch::async, [&] {
+    return create_session(env, model_config.model_path, args.threads, log);
+  });
+  std::future<void> pinyin_future;
   if (romanize) {
-    const fs::path& pinyin_table_path = args.pinyin_table;
-    log.info(std::string("Loading kanji pinyin table from: ") + pinyin_table_path.string());
-    if (!kanji::load_pinyin_table(pinyin_table_path.string())) {
-      throw std::runtime_error("Failed to load kanji pinyin table from: " + pinyin_table_path.string());
-    }
-    log.info("Kanji pinyin table loaded successfully");
+    // Load kanji pinyin table only if using romanization (MMS model)
+    pinyin_future = std::async(std::launch::async, [&] {
+      const fs::path& pinyin_table_path = args.pinyin_table;
+      log.info(std::string("Loading kanji pinyin table from: ") + pinyin_table_path.string());
+      if (!kanji::load_pinyin_table(pinyin_table_path.string())) {
+        throw std::runtime_error("Failed to load kanji pinyin table from: " + pinyin_table_path.string());
+      }
+      log.info("Kanji pinyin table loaded successfully");
+    });
   }
+  // Joins the startup threads once the caller's own loading has succeeded.
+  auto ready_session = [&](const Vocab& vocab) {
+    if (pinyin_future.valid()) pinyin_future.get();
+    Ort::Session session = session_future.get();
+    check_model_vocab(session, vocab);
+    return session;
+  };
 
-  const auto audio_samples = decode_audio_to_16k_mono(wav_path);
-  {
-    std::ostringstream ss;
-    ss << "Loaded audio: " << audio_samples.size() << " samples (" << (audio_samples.size() / 16000.0) << " seconds)";
-    log.info(ss.str());
+  PreprocessConfig prep_config;
+  prep_config.romanize = romanize;
+  prep_config.language = language;
+  const bool posterior_confidence = args.confidence == "posterior";
+  AudioInput audio_input;
+  audio_input.resampler = args.resampler == "polyphase" ? Resampler::Polyphase : Resampler::Linear;
+  audio_input.raw = args.raw_pcm;
+  audio_input.pcm_format = args.pcm_format == "f32le" ? PcmFormat::F32LE : PcmFormat::S16LE;
+
+  if (args.stream) {
+    // Live mode: no up-front decode; PCM and transcript pieces arrive incrementally.
+    const auto vocab = load_vocab(args.model_dir);
+    Ort::Session session = ready_session(vocab);
+    const int rc = run_stream_alignment(args, session, vocab, prep_config, log);
+    print_profile(romanize);
+    return rc;
   }
-  Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "cpp-ort-aligner");
-  Ort::SessionOptions opts;
-  int num_threads = args.threads;
-  if (num_threads <= 0) {
-    num_threads = static_cast<int>(std::thread::hardware_concurrency());
-    if (num_threads <= 0) num_threads = 4;
-    num_threads = std::max(4, (num_threads + 1) / 2);
+
+  if (!args.manifest.empty()) {
+    // Manifest mode: one session for every file of the list.
+    const auto vocab = load_model_vocab(args.model_dir, log);
+    Ort::Session session = ready_session(vocab);
+    const int rc = run_manifest(args, session, vocab, model_config, log);
+    print_profile(romanize);
+    return rc;
   }
-  opts.SetIntraOpNumThreads(num_threads);
-  opts.SetInterOpNumThreads(1);  // Keep inter-op at 1 for better cache locality
-  opts.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
-  {
-    std::ostringstream ss;
-    ss << "ORT threads: " << num_threads << ", graph optimization: ALL";
-    log.info(ss.str());
+
+  if (!args.dataset.empty()) {
+    // Dataset mode: short clips in padded cross-file batches.
+    const auto vocab = load_model_vocab(args.model_dir, log);
+    Ort::Session session = ready_session(vocab);
+    const int rc = run_dataset(args, session, vocab, model_config, log);
+    print_profile(romanize);
+    return rc;
   }
 
-  // Use model path from config (supports both model.onnx and model.int8.onnx)
-  const fs::path& model_onnx = model_config.model_path;
-#ifdef _WIN32
-  Ort::Session session(env, model_onnx.wstring().c_str(), opts);
-#else
-  Ort::Session session(env, model_onnx.string().c_str(), opts);
-#endif
+  if (args.serve) {
+    // Server mode: the session, vocab and pinyin table stay loaded across jobs.
+    const auto vocab = load_model_vocab(args.model_dir, log);
+    Ort::Session session = ready_session(vocab);
+    const int rc = run_server(args, session, vocab, model_config, log);
+    print_profile(romanize);
+    return rc;
+  }
 
-  auto emissions = generate_emissions_ort(
-      session,
-      audio_samples,
-      /*window_seconds=*/30,
-      /*context_seconds=*/2,
-      /*batch_size=*/batch_size,
-      /*star_logp=*/0.0f);
+  if (args.long_form) {
+    auto srt_segments = read_input_segments(args, log);
+    const std::vector<SrtSegment> original_segments_for_debug = args.debug ? srt_segments : std::vector<SrtSegment>{};
+    const auto vocab = load_model_vocab(args.model_dir, log);
+    Ort::Session session = ready_session(vocab);
+    try {
+      const double audio_duration = align_long_form(srt_segments, wav_path, audio_input, args.section_seconds, session,
+                                                     batch_size, vocab, prep_config, model_config,
+                                                     posterior_confidence, log);
+      write_alignment_outputs(args, srt_segments, original_segments_for_debug, romanize, audio_duration, log);
+    } catch (const std::exception& e) {
+      log.error(std::string("Alignment failed: ") + e.what());
+      throw;
+    }
+    print_profile(romanize);
+    return 0;
+  }
 
-  {
-    std::ostringstream ss;
-    ss << "emissions shape: [" << emissions.frames << "," << emissions.classes << "] stride_ms=" << emissions.stride_ms;
-    log.info(ss.str());
+  if (args.has_range()) {
+    auto srt_segments = read_input_segments(args, log);
+    const std::vector<SrtSegment> original_segments_for_debug = args.debug ? srt_segments : std::vector<SrtSegment>{};
+    const auto vocab = load_model_vocab(args.model_dir, log);
+    Ort::Session session = ready_session(vocab);
+    try {
+      const double audio_duration = align_range(srt_segments, args, audio_input, session, batch_size, vocab,
+                                                prep_config, model_config, posterior_confidence, log);
+      write_alignment_outputs(args, srt_segments, original_segments_for_debug, romanize, audio_duration, log);
+    } catch (const std::exception& e) {
+      log.error(std::string("Alignment failed: ") + e.what());
+      throw;
+    }
+    print_profile(romanize);
+    return 0;
   }
 
-  std::vector<SrtSegment> srt_segments;
+  auto srt_segments = read_input_segments(args, log);
+  const std::vector<SrtSegment> original_segments_for_debug = args.debug ? srt_segments : std::vector<SrtSegment>{};
+  const auto vocab = load_model_vocab(args.model_dir, log);
+
+  // PCM used in place has nothing to overlap, and a long WAV/FLAC decodes as time ranges on all
+  // cores in a fraction of the inference time, so both are loaded whole. Anything else needs one
+  // decoder running through the file and goes through decode -> inference -> post-processing
+  // stages instead, so the model starts on the first window while the rest is still decoding.
+  AudioSamples audio_samples;
+  std::unique_ptr<AudioReader> reader;
+  if (wav_path.string() == "-") {
+    audio_samples = load_audio_16k_mono(wav_path, audio_input);
+  } else if (!load_audio_without_serial_decode(wav_path, audio_input, audio_samples)) {
+    reader = std::make_unique<AudioReader>(wav_path, audio_input);
+  }
 
-  // Read segments from JSON or SRT input
-  if (!args.json_input.empty()) {
-    if (args.json_input.string() == "-") {
-      // Read from stdin
-      std::ostringstream ss;
-      ss << std::cin.rdbuf();
-      srt_segments = parse_json_input(ss.str());
-    } else {
-      srt_segments = read_json_input(args.json_input);
-    }
-    {
-      std::ostringstream ss;
-      ss << "Read " << srt_segments.size() << " segments from JSON input";
-      log.info(ss.str());
-    }
+  int64_t num_samples = 0;
+  if (!reader) {
+    num_samples = static_cast<int64_t>(audio_samples.size());
+    std::ostringstream ss;
+    ss << "Loaded audio: " << audio_samples.size() << " samples (" << (audio_samples.size() / 16000.0) << " seconds"
+       << (audio_samples.mapped() ? ", mapped in place" : "") << ")";
+    log.info(ss.str());
+  }
+  Ort::Session session = ready_session(vocab);
+
+  Emissions emissions;
+  if (reader) {
+    constexpr int64_t kPipelineBlockSamples = 10 * 16000;
+    int64_t position = 0;
+    emissions = generate_emissions_pipelined(
+        session,
+        [&] {
+          auto block = reader->read(position, kPipelineBlockSamples);
+          position += static_cast<int64_t>(block.size());
+          return block;
+        },
+        /*window_seconds=*/30,
+        /*context_seconds=*/2,
+        /*batch_size=*/batch_size,
+        /*star_logp=*/0.0f,
+        num_samples);
+    std::ostringstream ss;
+    ss << "Decoded audio: " << num_samples << " samples (" << (num_samples / 16000.0)
+       << " seconds, pipelined with inference)";
+    log.info(ss.str());
   } else {
-    srt_segments = read_srt_utf8(args.srt);
+    emissions = generate_emissions_ort(
+        session,
+        audio_samples.data(),
+        audio_samples.size(),
+        /*window_seconds=*/30,
+        /*context_seconds=*/2,
+        /*batch_size=*/batch_size,
+        /*star_logp=*/0.0f);
   }
-  const std::vector<SrtSegment> original_segments_for_debug = args.debug ? srt_segments : std::vector<SrtSegment>{};
 
-  // Load vocab
-  const auto vocab = load_vocab(args.model_dir);
   {
     std::ostringstream ss;
-    ss << "Loaded vocab: " << vocab.vocab_size() << " tokens (format: "
-       << (vocab.format == VocabFormat::JSON ? "JSON" : "TXT") << ")";
+    ss << "emissions shape: [" << emissions.frames << "," << emissions.classes << "] stride_ms=" << emissions.stride_ms;
     log.info(ss.str());
   }
-  if (vocab.star_id != emissions.classes - 1) {
-    throw std::runtime_error(
-        "vocab size mismatch: emissions classes=" + std::to_string(emissions.classes) + ", vocab+star=" +
-        std::to_string(vocab.star_id + 1) + " (check matching model + vocab file)");
-  }
 
-  // Run alignment with automatic sub-batching for CTC constraint violations
-  PreprocessConfig prep_config;
-  prep_config.romanize = romanize;
-  prep_config.language = language;
+  check_vocab_matches(vocab, emissions.classes);
 
+  // Run alignment with automatic sub-batching for CTC constraint violations
   try {
-    align_and_map_batch(srt_segments, emissions.log_probs.data(), 0, emissions.frames,
-                        emissions.classes, emissions.stride_ms, vocab, prep_config, model_config, log);
-
-    // Write output in JSON or SRT format
-    if (!args.json_output.empty()) {
-      if (args.json_output.string() == "-") {
-        std::cout << format_json_output(srt_segments, 0.0);
-      } else {
-        write_json_output(args.json_output, srt_segments, 0.0);
-        log.info(std::string("Wrote aligned JSON: ") + args.json_output.string());
-      }
-    } else {
-      write_srt_utf8(args.output, srt_segments);
-      log.info(std::string("Wrote aligned SRT: ") + args.output.string());
-    }
-
-    if (args.debug && !args.debug_dir.empty()) {
-      fs::create_directories(args.debug_dir);
-      using json = nlohmann::json;
-
-      // 01_original_segments.json
-      {
-        json j = json::array();
-        for (size_t i = 0; i < original_segments_for_debug.size(); ++i) {
-          const auto& seg = original_segments_for_debug[i];
-          j.push_back({{"index", i + 1}, {"start", seg.start_sec}, {"end", seg.end_sec},
-                        {"text", seg.text}, {"score", seg.score}});
-        }
-        std::ofstream f(args.debug_dir / "01_original_segments.json", std::ios::binary);
-        f << j.dump(2) << "\n";
-      }
-      // 06_aligned_segments.json
-      {
-        json j = json::array();
-        for (size_t i = 0; i < srt_segments.size(); ++i) {
-          const auto& seg = srt_segments[i];
-          j.push_back({{"index", i + 1}, {"start", seg.start_sec}, {"end", seg.end_sec},
-                        {"text", seg.text}, {"score", seg.score}});
-        }
-        std::ofstream f(args.debug_dir / "06_aligned_segments.json", std::ios::binary);
-        f << j.dump(2) << "\n";
-      }
-      // 00_summary.json
-      {
-        json j = {
-          {"audio_path", args.audio.string()},
-          {"srt_path", args.srt.string()},
-          {"language", language},
-          {"romanize", romanize},
-          {"audio_duration", audio_samples.size() / 16000.0},
-          {"num_segments", srt_segments.size()},
-          {"processing_time", 0.0}
-        };
-        std::ofstream f(args.debug_dir / "00_summary.json", std::ios::binary);
-        f << j.dump(2) << "\n";
-      }
-    }
+    align_segments(srt_segments, emissions.log_probs.data(), emissions.frames, emissions.classes,
+                   emissions.stride_ms, vocab, prep_config, model_config, posterior_confidence,
+                   /*threads=*/0, log);
+    write_alignment_outputs(args, srt_segments, original_segments_for_debug, romanize, num_samples / 16000.0,
+                            log);
   } catch (const std::exception& e) {
     log.error(std::string("Alignment failed: ") + e.what());
     throw;
   }
 
+  print_profile(romanize);
   return 0;
 }
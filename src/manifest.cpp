@@ -0,0 +1,490 @@
+#include "manifest.h"
+
+#include "audio_decode.h"
+#include "batch_align.h"
+#include "bounded_queue.h"
+#include "emissions.h"
+#include "json_io.h"
+#include "srt_io.h"
+#include "text_preprocess.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+using clock_type = std::chrono::steady_clock;
+
+struct ManifestEntry {
+  fs::path audio;
+  fs::path subtitle;  // empty: `text` is the whole clip's transcript
+  std::string text;
+  fs::path output;
+  std::string language;
+};
+
+struct FileResult {
+  bool ok = false;
+  std::string error;
+  double audio_seconds = 0.0;
+  size_t segments = 0;
+  double decode_seconds = 0.0;
+  double infer_seconds = 0.0;
+  double align_seconds = 0.0;
+};
+
+// One file on its way through the stages; `failed` skips the remaining stages.
+struct FileWork {
+  size_t index = 0;
+  bool failed = false;
+  std::vector<SrtSegment> segments;
+  AudioSamples audio;
+  Emissions emissions;
+};
+
+double seconds_since(clock_type::time_point t) {
+  return std::chrono::duration<double>(clock_type::now() - t).count();
+}
+
+// Reads manifest entries one line at a time, so a dataset manifest of millions of clips is never
+// held whole.
+class ManifestReader {
+ public:
+  ManifestReader(const fs::path& path, std::string default_language)
+      : path_(path), base_(path.parent_path()), default_language_(std::move(default_language)) {
+    file_.open(path, std::ios::binary);
+    if (!file_) throw std::runtime_error("Failed to open manifest: " + path.string());
+  }
+
+  // False at the end of the manifest; throws on a malformed line.
+  bool next(ManifestEntry& entry) {
+    std::string line;
+    while (std::getline(file_, line)) {
+      ++line_no_;
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      const size_t first = line.find_first_not_of(" \t");
+      if (first == std::string::npos || line[first] == '#') continue;
+      try {
+        entry = parse(json::parse(line));
+      } catch (const std::exception& ex) {
+        throw std::runtime_error(path_.string() + ":" + std::to_string(line_no_) + ": " + ex.what());
+      }
+      return true;
+    }
+    return false;
+  }
+
+ private:
+  fs::path resolve(const std::string& p) const {
+    const fs::path q(p);
+    return q.is_relative() ? base_ / q : q;
+  }
+
+  ManifestEntry parse(const json& j) const {
+    if (!j.is_object()) throw std::runtime_error("expected an object");
+    ManifestEntry e;
+    if (!j.contains("audio")) throw std::runtime_error("missing \"audio\"");
+    e.audio = resolve(j["audio"].get<std::string>());
+    if (j.contains("srt")) {
+      e.subtitle = resolve(j["srt"].get<std::string>());
+    } else if (j.contains("json_input")) {
+      e.subtitle = resolve(j["json_input"].get<std::string>());
+    } else if (j.contains("text")) {
+      e.text = j["text"].get<std::string>();
+    } else {
+      throw std::runtime_error("missing \"srt\", \"json_input\" or \"text\"");
+    }
+    if (j.contains("output")) {
+      e.output = resolve(j["output"].get<std::string>());
+    } else {
+      const fs::path& named = e.subtitle.empty() ? e.audio : e.subtitle;
+      e.output = fs::path((named.parent_path() / named.stem()).string() + "_aligned.srt");
+    }
+    e.language = j.value("language", default_language_);
+    return e;
+  }
+
+  fs::path path_;
+  fs::path base_;
+  std::string default_language_;
+  std::ifstream file_;
+  int line_no_ = 0;
+};
+
+// The entry's segments; a "text" entry is one segment spanning the whole clip.
+std::vector<SrtSegment> read_segments(const ManifestEntry& entry, double audio_seconds) {
+  if (entry.subtitle.empty()) {
+    SrtSegment seg;
+    seg.index = 1;
+    seg.end_sec = audio_seconds;
+    seg.text = entry.text;
+    return {seg};
+  }
+  if (entry.subtitle.extension() == ".json") return read_json_input(entry.subtitle);
+  return read_srt_utf8(entry.subtitle);
+}
+
+AudioInput audio_input_for(const CliArgs& args, const fs::path& audio) {
+  AudioInput input;
+  input.resampler = args.resampler == "polyphase" ? Resampler::Polyphase : Resampler::Linear;
+  input.pcm_format = args.pcm_format == "f32le" ? PcmFormat::F32LE : PcmFormat::S16LE;
+  const std::string ext = audio.extension().string();
+  input.raw = args.raw_pcm || ext == ".raw" || ext == ".pcm" || ext == ".RAW" || ext == ".PCM";
+  return input;
+}
+
+void check_classes(const Emissions& em, const Vocab& vocab) {
+  if (em.classes != vocab.star_id + 1) {
+    throw std::runtime_error(
+        "vocab size mismatch: emissions classes=" + std::to_string(em.classes) + ", vocab+star=" +
+        std::to_string(vocab.star_id + 1) + " (check matching model + vocab file)");
+  }
+}
+
+void write_output(const fs::path& path, const std::vector<SrtSegment>& segments) {
+  if (path.extension() == ".json") {
+    write_json_output(path, segments, 0.0);
+  } else {
+    write_srt_utf8(path, segments);
+  }
+}
+
+void log_summary(const std::vector<ManifestEntry>& entries, const std::vector<FileResult>& results, double wall,
+                 Logger& log) {
+  size_t ok = 0;
+  double audio = 0.0;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const FileResult& r = results[i];
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1) << "[manifest] " << (i + 1) << "/" << entries.size() << " "
+       << entries[i].audio.filename().string() << ": ";
+    if (r.ok) {
+      ++ok;
+      audio += r.audio_seconds;
+      ss << "ok, " << r.segments << " segments, " << r.audio_seconds << " s audio, decode "
+         << r.decode_seconds * 1000 << " ms, infer " << r.infer_seconds * 1000 << " ms, align "
+         << r.align_seconds * 1000 << " ms -> " << entries[i].output.string();
+      log.info(ss.str());
+    } else {
+      ss << "FAILED: " << r.error;
+      log.error(ss.str());
+    }
+  }
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(1) << "[manifest] " << entries.size() << " files, " << ok << " ok, "
+     << (entries.size() - ok) << " failed; " << audio << " s audio in " << wall << " s ("
+     << (wall > 0.0 ? audio / wall : 0.0) << "x realtime)";
+  log.info(ss.str());
+}
+
+// Dataset mode: clips decoded per pool, which is sorted by length and cut into batches.
+constexpr size_t kPoolBatches = 16;
+constexpr size_t kWindowSamples = 30 * 16000;
+
+struct Clip {
+  size_t index = 0;  // entry number in the manifest, from 0
+  fs::path audio_path;
+  std::string language;
+  std::string error;  // non-empty: failed, skips the remaining stages
+  double audio_seconds = 0.0;
+  std::vector<SrtSegment> segments;
+  AudioSamples audio;
+  Emissions emissions;
+};
+
+std::string clip_reply(const Clip& clip) {
+  json reply;
+  reply["index"] = clip.index;
+  reply["audio"] = clip.audio_path.string();
+  if (!clip.error.empty()) {
+    reply["ok"] = false;
+    reply["error"] = clip.error;
+    return reply.dump();
+  }
+  json segments = json::array();
+  for (const auto& seg : clip.segments) {
+    segments.push_back({{"index", seg.index}, {"start", seg.start_sec}, {"end", seg.end_sec}, {"text", seg.text},
+                        {"score", seg.score}});
+  }
+  reply["ok"] = true;
+  reply["audio_duration"] = clip.audio_seconds;
+  reply["segments"] = std::move(segments);
+  return reply.dump();
+}
+
+}  // namespace
+
+int run_manifest(
+    const CliArgs& args,
+    Ort::Session& session,
+    const Vocab& vocab,
+    const ModelConfig& model_config,
+    Logger& log) {
+  const auto t_begin = clock_type::now();
+  std::vector<ManifestEntry> entries;
+  {
+    ManifestReader reader(args.manifest, args.language);
+    for (ManifestEntry e; reader.next(e);) entries.push_back(std::move(e));
+  }
+  {
+    std::ostringstream ss;
+    ss << "[manifest] " << entries.size() << " files from " << args.manifest.string();
+    log.info(ss.str());
+  }
+
+  const bool posterior_confidence = args.confidence == "posterior";
+
+  // One file waits between stages, so at most three files (decoded audio, emissions) are held.
+  BoundedQueue<FileWork> decoded(1);
+  BoundedQueue<FileWork> inferred(1);
+  std::vector<FileResult> results(entries.size());
+  auto fail = [&](FileWork& work, const std::exception& e) {
+    work.failed = true;
+    results[work.index].error = e.what();
+  };
+
+  std::thread decoder([&] {
+    for (size_t i = 0; i < entries.size(); ++i) {
+      FileWork work;
+      work.index = i;
+      const auto t0 = clock_type::now();
+      try {
+        work.audio = load_audio_16k_mono(entries[i].audio, audio_input_for(args, entries[i].audio));
+        results[i].audio_seconds = double(work.audio.size()) / 16000.0;
+        work.segments = read_segments(entries[i], results[i].audio_seconds);
+      } catch (const std::exception& e) {
+        fail(work, e);
+      }
+      results[i].decode_seconds = seconds_since(t0);
+      if (!decoded.push(std::move(work))) break;
+    }
+    decoded.close();
+  });
+
+  std::thread aligner([&] {
+    while (auto work = inferred.pop()) {
+      if (work->failed) continue;
+      const ManifestEntry& entry = entries[work->index];
+      FileResult& result = results[work->index];
+      const auto t0 = clock_type::now();
+      try {
+        const Emissions& em = work->emissions;
+        check_classes(em, vocab);
+        PreprocessConfig prep_config;
+        prep_config.romanize = model_config.requires_romanization && args.romanize;
+        prep_config.language = entry.language;
+        align_segments(work->segments, em.log_probs.data(), em.frames, em.classes, em.stride_ms, vocab,
+                       prep_config, model_config, posterior_confidence, /*threads=*/0, log);
+        write_output(entry.output, work->segments);
+        result.segments = work->segments.size();
+        result.ok = true;
+      } catch (const std::exception& e) {
+        fail(*work, e);
+      }
+      result.align_seconds = seconds_since(t0);
+    }
+  });
+
+  // Inference runs on this thread, between the decoder and the aligner.
+  while (auto work = decoded.pop()) {
+    if (!work->failed) {
+      const auto t0 = clock_type::now();
+      try {
+        work->emissions = generate_emissions_ort(
+            session, work->audio.data(), work->audio.size(), /*window_seconds=*/30, /*context_seconds=*/2,
+            /*batch_size=*/args.batch_size, /*star_logp=*/0.0f);
+      } catch (const std::exception& e) {
+        fail(*work, e);
+      }
+      work->audio = AudioSamples();
+      results[work->index].infer_seconds = seconds_since(t0);
+    }
+    inferred.push(std::move(*work));
+  }
+  inferred.close();
+  decoder.join();
+  aligner.join();
+
+  log_summary(entries, results, seconds_since(t_begin), log);
+  for (const auto& r : results) {
+    if (!r.ok) return 1;
+  }
+  return 0;
+}
+
+int run_dataset(
+    const CliArgs& args,
+    Ort::Session& session,
+    const Vocab& vocab,
+    const ModelConfig& model_config,
+    Logger& log) {
+  const auto t_begin = clock_type::now();
+  const size_t batch_size = size_t(std::max(1, args.batch_size));
+  const size_t pool_size = batch_size * kPoolBatches;
+  const bool posterior_confidence = args.confidence == "posterior";
+
+  std::ofstream out_file;
+  const bool out_stdout = args.json_output.empty() || args.json_output.string() == "-";
+  if (!out_stdout) {
+    out_file.open(args.json_output, std::ios::binary);
+    if (!out_file) throw std::runtime_error("Failed to open for writing: " + args.json_output.string());
+  }
+  std::ostream& out = out_stdout ? static_cast<std::ostream&>(std::cout) : out_file;
+  std::mutex out_mutex;
+  size_t clips_done = 0;
+  size_t clips_failed = 0;
+  double audio_seconds = 0.0;
+
+  // Stage 1: read and decode the manifest a pool at a time.
+  BoundedQueue<std::vector<Clip>> pools(1);
+  std::exception_ptr reader_error;
+  std::thread decoder([&] {
+    std::vector<Clip> pool;
+    try {
+      ManifestReader reader(args.dataset, args.language);
+      size_t index = 0;
+      for (bool more = true; more;) {
+        ManifestEntry entry;
+        while (pool.size() < pool_size && (more = reader.next(entry))) {
+          Clip clip;
+          clip.index = index++;
+          clip.audio_path = entry.audio;
+          clip.language = entry.language;
+          try {
+            clip.audio = load_audio_16k_mono(entry.audio, audio_input_for(args, entry.audio));
+            clip.audio_seconds = double(clip.audio.size()) / 16000.0;
+            clip.segments = read_segments(entry, clip.audio_seconds);
+          } catch (const std::exception& e) {
+            clip.error = e.what();
+          }
+          pool.push_back(std::move(clip));
+        }
+        if (!pool.empty() && !pools.push(std::move(pool))) break;
+        pool.clear();
+      }
+    } catch (...) {
+      // A malformed line ends the manifest; the clips decoded before it are still aligned.
+      if (!pool.empty()) pools.push(std::move(pool));
+      reader_error = std::current_exception();
+    }
+    pools.close();
+  });
+
+  // Stage 3: align each clip and write its result line.
+  BoundedQueue<Clip> inferred(pool_size);
+  const size_t align_workers = std::max<size_t>(1, std::thread::hardware_concurrency() / 2);
+  std::vector<std::thread> aligners;
+  for (size_t w = 0; w < align_workers; ++w) {
+    aligners.emplace_back([&] {
+      while (auto clip = inferred.pop()) {
+        if (clip->error.empty()) {
+          try {
+            const Emissions& em = clip->emissions;
+            check_classes(em, vocab);
+            PreprocessConfig prep_config;
+            prep_config.romanize = model_config.requires_romanization && args.romanize;
+            prep_config.language = clip->language;
+            align_segments(clip->segments, em.log_probs.data(), em.frames, em.classes, em.stride_ms, vocab,
+                           prep_config, model_config, posterior_confidence, /*threads=*/1, log);
+          } catch (const std::exception& e) {
+            clip->error = e.what();
+          }
+        }
+        const std::string line = clip_reply(*clip);
+        std::lock_guard<std::mutex> lock(out_mutex);
+        out << line << "\n";
+        ++clips_done;
+        if (clip->error.empty()) {
+          audio_seconds += clip->audio_seconds;
+        } else {
+          ++clips_failed;
+        }
+      }
+    });
+  }
+
+  // Stage 2, on this thread: clips of a pool in length order, batch_size at a time, so each batch
+  // pads its clips to a similar length. Clips of a window or longer run alone, windowed.
+  size_t batches = 0;
+  uint64_t real_samples = 0;
+  uint64_t padded_samples = 0;
+  while (auto pool = pools.pop()) {
+    std::vector<size_t> order;
+    for (size_t i = 0; i < pool->size(); ++i) {
+      Clip& clip = (*pool)[i];
+      if (!clip.error.empty()) {
+        inferred.push(std::move(clip));
+      } else if (clip.audio.size() >= kWindowSamples) {
+        try {
+          clip.emissions = generate_emissions_ort(session, clip.audio.data(), clip.audio.size(),
+                                                  /*window_seconds=*/30, /*context_seconds=*/2,
+                                                  /*batch_size=*/args.batch_size, /*star_logp=*/0.0f);
+        } catch (const std::exception& e) {
+          clip.error = e.what();
+        }
+        clip.audio = AudioSamples();
+        inferred.push(std::move(clip));
+      } else {
+        order.push_back(i);
+      }
+    }
+    std::sort(order.begin(), order.end(),
+              [&](size_t a, size_t b) { return (*pool)[a].audio.size() < (*pool)[b].audio.size(); });
+
+    for (size_t first = 0; first < order.size(); first += batch_size) {
+      const size_t last = std::min(order.size(), first + batch_size);
+      std::vector<const float*> clips;
+      std::vector<size_t> lengths;
+      for (size_t k = first; k < last; ++k) {
+        const Clip& clip = (*pool)[order[k]];
+        clips.push_back(clip.audio.data());
+        lengths.push_back(clip.audio.size());
+        real_samples += clip.audio.size();
+      }
+      padded_samples += uint64_t(lengths.back()) * lengths.size();
+      ++batches;
+      try {
+        auto emissions = generate_emissions_batch(session, clips, lengths, /*star_logp=*/0.0f);
+        for (size_t k = first; k < last; ++k) (*pool)[order[k]].emissions = std::move(emissions[k - first]);
+      } catch (const std::exception& e) {
+        for (size_t k = first; k < last; ++k) (*pool)[order[k]].error = e.what();
+      }
+      for (size_t k = first; k < last; ++k) {
+        Clip& clip = (*pool)[order[k]];
+        clip.audio = AudioSamples();
+        inferred.push(std::move(clip));
+      }
+    }
+  }
+  inferred.close();
+  for (auto& t : aligners) t.join();
+  decoder.join();
+  out.flush();
+
+  const double wall = seconds_since(t_begin);
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(2) << "[dataset] " << clips_done << " clips, " << clips_failed
+     << " failed; " << audio_seconds / 3600.0 << " audio-hours in " << wall << " s: "
+     << (wall > 0.0 ? audio_seconds / wall : 0.0) << " audio-hours per wall-hour (" << batches << " batches of up to "
+     << batch_size << ", " << (padded_samples ? 100.0 * double(padded_samples - real_samples) / double(padded_samples)
+                                              : 0.0)
+     << "% padding)";
+  log.info(ss.str());
+  if (reader_error) std::rethrow_exception(reader_error);
+  return clips_failed > 0 ? 1 : 0;
+}
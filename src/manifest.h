@@ -0,0 +1,38 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+
+#include "cli_args.h"
+#include "logger.h"
+#include "model_config.h"
+#include "vocab.h"
+
+// Manifest mode (--manifest).
+// Aligns every file listed in args.manifest, one JSON object per line:
+//   {"audio": path, "srt": path | "json_input": path | "text": transcript, optional "output", "language"}
+// Relative paths are taken from the manifest's directory. The output defaults to
+// <subtitle>_aligned.srt; a .json output is written in the --json-output format. Files go through
+// three overlapping stages: the next file is decoded while the current one runs through the model
+// and the previous one is aligned and written. A failed file is reported and skipped. Logs a
+// per-file status and timing summary at the end; returns 1 if any file failed.
+int run_manifest(
+    const CliArgs& args,
+    Ort::Session& session,
+    const Vocab& vocab,
+    const ModelConfig& model_config,
+    Logger& log);
+
+// Dataset mode (--dataset): many short clips, listed like --manifest entries (usually with an
+// inline "text" transcript). The manifest is read and decoded a pool of 16 batches at a time; each
+// pool is sorted by length and run through the model as zero-padded [--batch-size, samples]
+// batches whose emissions are split back per clip (clips of 30 s or more run alone), and the
+// clips are then aligned on several threads. One JSON line per clip, {"index", "audio", "ok",
+// "audio_duration", "segments"} or {"index", "audio", "ok": false, "error"}, goes to --json-output
+// (stdout by default) in completion order. Logs throughput in audio-hours per wall-hour; returns
+// 1 if any clip failed.
+int run_dataset(
+    const CliArgs& args,
+    Ort::Session& session,
+    const Vocab& vocab,
+    const ModelConfig& model_config,
+    Logger& log);
@@ -0,0 +1,98 @@
+#include "mmap_file.h"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Failed to open " + path.string());
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    CloseHandle(file);
+    throw std::runtime_error("Failed to stat " + path.string());
+  }
+  if (size.QuadPart == 0) {
+    CloseHandle(file);
+    return;
+  }
+  HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (!mapping) throw std::runtime_error("Failed to map " + path.string());
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!view) {
+    CloseHandle(mapping);
+    throw std::runtime_error("Failed to map " + path.string());
+  }
+  mapping_ = mapping;
+  data_ = static_cast<const char*>(view);
+  size_ = size_t(size.QuadPart);
+}
+
+void MappedFile::release() {
+  if (data_) UnmapViewOfFile(data_);
+  if (mapping_) CloseHandle(static_cast<HANDLE>(mapping_));
+  data_ = nullptr;
+  size_ = 0;
+  mapping_ = nullptr;
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("Failed to open " + path.string());
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Failed to stat " + path.string());
+  }
+  if (st.st_size == 0) {
+    ::close(fd);
+    return;
+  }
+  void* view = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (view == MAP_FAILED) throw std::runtime_error("Failed to map " + path.string());
+  data_ = static_cast<const char*>(view);
+  size_ = size_t(st.st_size);
+}
+
+void MappedFile::release() {
+  if (data_) ::munmap(const_cast<char*>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile() { release(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    release();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+#ifdef _WIN32
+    mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+  }
+  return *this;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+// Read-only memory mapping of a whole file. Pages are faulted in on first access, so opening
+// is cheap regardless of file size. Move-only; the mapping is released on destruction.
+// An empty file maps to data() == nullptr, size() == 0.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  // Throws std::runtime_error if the file cannot be opened or mapped.
+  explicit MappedFile(const std::filesystem::path& path);
+  ~MappedFile();
+
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+ private:
+  void release();
+
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void* mapping_ = nullptr;  // HANDLE
+#endif
+};
@@ -0,0 +1,289 @@
+#include "online_align.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Score margin (nats) below the best state at which band edges are pruned.
+constexpr float kBeam = 80.0f;
+// Dropped-target slack before the target buffer is compacted.
+constexpr int64_t kTrimSlack = 4096;
+
+}  // namespace
+
+OnlineAligner::OnlineAligner(int64_t classes, int64_t blank, int64_t star_id, float log_vocab,
+                             int64_t max_latency_frames, Callback on_segment)
+    : classes_(classes),
+      blank_(blank),
+      star_id_(star_id),
+      log_vocab_(log_vocab),
+      max_latency_frames_(std::max<int64_t>(2, max_latency_frames)),
+      on_segment_(std::move(on_segment)) {}
+
+void OnlineAligner::append_segment(const std::vector<int64_t>& targets) {
+  Seg seg;
+  seg.target_begin = num_targets_;
+  const size_t seg_index = seg_base_ + segs_.size();
+  for (int64_t id : targets) {
+    targets_.push_back(id);
+    target_seg_.push_back(seg_index);
+  }
+  num_targets_ += int64_t(targets.size());
+  seg.target_end = num_targets_;
+  segs_.push_back(seg);
+  if (!targets.empty()) replay();
+}
+
+void OnlineAligner::push_frame(const float* row) {
+  Frame f;
+  f.row.assign(row, row + classes_);
+  pending_.push_back(std::move(f));
+  step(pending_.back());
+  try_commit();
+}
+
+void OnlineAligner::step(Frame& f) {
+  const float neg_inf = -std::numeric_limits<float>::infinity();
+  const int64_t S = num_states();
+  const float* row = f.row.data();
+
+  int64_t nlo = 0;
+  int64_t nhi = 0;
+  std::vector<int8_t> bp;
+  next_.clear();
+  if (!have_dp_) {
+    nhi = std::min<int64_t>(S, 2);
+    for (int64_t s = 0; s < nhi; ++s) next_.push_back(row[label(s)]);
+    bp.assign(size_t(nhi), 0);
+  } else {
+    const int64_t lo = lo_;
+    const int64_t hi = lo_ + int64_t(score_.size());
+    auto prev = [&](int64_t s) { return (s >= lo && s < hi) ? score_[size_t(s - lo)] : neg_inf; };
+    nlo = lo;
+    nhi = std::min<int64_t>(S, hi + 2);
+    bp.resize(size_t(nhi - nlo));
+    for (int64_t s = nlo; s < nhi; ++s) {
+      // Same transitions and tie-breaking as forced_align().
+      const float x0 = prev(s);
+      const float x1 = prev(s - 1);
+      const float x2 = can_skip(s) ? prev(s - 2) : neg_inf;
+      float best = x0;
+      int8_t b = 0;
+      if (x2 > x1 && x2 > x0) {
+        best = x2;
+        b = 2;
+      } else if (x1 > x0 && x1 > x2) {
+        best = x1;
+        b = 1;
+      }
+      bp[size_t(s - nlo)] = b;
+      next_.push_back(best + row[label(s)]);
+    }
+  }
+
+  // Prune band edges that fell out of the beam, then renormalize so scores stay small.
+  const float m = *std::max_element(next_.begin(), next_.end());
+  size_t a = 0;
+  size_t b = next_.size();
+  if (m != neg_inf) {
+    while (a < b && !(next_[a] >= m - kBeam)) ++a;
+    while (b > a && !(next_[b - 1] >= m - kBeam)) --b;
+  }
+  f.lo = nlo + int64_t(a);
+  f.bp.assign(bp.begin() + std::ptrdiff_t(a), bp.begin() + std::ptrdiff_t(b));
+  lo_ = f.lo;
+  score_.assign(next_.begin() + std::ptrdiff_t(a), next_.begin() + std::ptrdiff_t(b));
+  if (m != neg_inf) {
+    for (float& v : score_) v -= m;
+  }
+  have_dp_ = true;
+}
+
+void OnlineAligner::replay() {
+  if (pending_.empty()) return;
+  if (commit_state_ < 0) {
+    have_dp_ = false;
+  } else {
+    have_dp_ = true;
+    lo_ = commit_state_;
+    score_.assign(1, 0.0f);
+  }
+  for (auto& f : pending_) step(f);
+  try_commit();
+}
+
+void OnlineAligner::try_commit() {
+  if (pending_.empty()) return;
+  // Before the first transcript piece every frame sits on the lone blank state; keep them (up to
+  // the latency bound) so the first segment can still claim audio that streamed in ahead of it.
+  if (num_targets_ == 0 && !text_closed_) {
+    if (int64_t(pending_.size()) > max_latency_frames_) force_commit(size_t(max_latency_frames_ / 2));
+    return;
+  }
+
+  // Walk all surviving states back until they share one ancestor.
+  std::vector<int64_t> states;
+  states.reserve(score_.size());
+  for (size_t j = 0; j < score_.size(); ++j) {
+    if (score_[j] != -std::numeric_limits<float>::infinity()) states.push_back(lo_ + int64_t(j));
+  }
+  size_t i = pending_.size() - 1;
+  while (states.size() > 1 && i > 0) {
+    for (auto& s : states) s -= back_ptr(i, s);
+    std::sort(states.begin(), states.end());
+    states.erase(std::unique(states.begin(), states.end()), states.end());
+    --i;
+  }
+  if (states.size() == 1) commit(i, states[0], /*wait_for_text=*/true);
+
+  if (int64_t(pending_.size()) > max_latency_frames_) force_commit(size_t(max_latency_frames_ / 2));
+}
+
+void OnlineAligner::force_commit(size_t keep) {
+  const float neg_inf = -std::numeric_limits<float>::infinity();
+  if (pending_.size() <= keep || score_.empty()) return;
+  const size_t upto = pending_.size() - 1 - keep;
+
+  // Ancestor at frame `upto` of every surviving state.
+  std::vector<int64_t> anc(score_.size());
+  for (size_t j = 0; j < anc.size(); ++j) anc[j] = lo_ + int64_t(j);
+  for (size_t i = pending_.size() - 1; i > upto; --i) {
+    for (size_t j = 0; j < anc.size(); ++j) {
+      if (score_[j] != neg_inf) anc[j] -= back_ptr(i, anc[j]);
+    }
+  }
+  const size_t best = size_t(std::max_element(score_.begin(), score_.end()) - score_.begin());
+  const int64_t chosen = anc[best];
+
+  // Paths that disagree with the committed prefix can no longer win.
+  for (size_t j = 0; j < score_.size(); ++j) {
+    if (anc[j] != chosen) score_[j] = neg_inf;
+  }
+  size_t a = 0;
+  size_t b = score_.size();
+  while (a < b && score_[a] == neg_inf) ++a;
+  while (b > a && score_[b - 1] == neg_inf) --b;
+  lo_ += int64_t(a);
+  score_.assign(score_.begin() + std::ptrdiff_t(a), score_.begin() + std::ptrdiff_t(b));
+
+  commit(upto, chosen, /*wait_for_text=*/false);
+}
+
+void OnlineAligner::commit(size_t upto, int64_t state, bool wait_for_text) {
+  std::vector<int64_t> states(upto + 1);
+  states[upto] = state;
+  for (size_t i = upto; i > 0; --i) states[i - 1] = states[i] - back_ptr(i, states[i]);
+
+  // While text can still arrive, stop at the first frame on the trailing blank: frames after it
+  // may belong to transcript pieces that have not been appended yet.
+  size_t cut = upto;
+  if (wait_for_text && !text_closed_) {
+    const int64_t trailing = num_states() - 1;
+    for (size_t i = 0; i <= upto; ++i) {
+      if (states[i] == trailing) {
+        cut = i;
+        break;
+      }
+    }
+  }
+
+  for (size_t i = 0; i <= cut; ++i) consume_frame(base_frame_ + int64_t(i), states[i], pending_[i].row.data());
+  pending_.erase(pending_.begin(), pending_.begin() + std::ptrdiff_t(cut + 1));
+  base_frame_ += int64_t(cut + 1);
+  commit_state_ = states[cut];
+  trim();
+}
+
+void OnlineAligner::consume_frame(int64_t frame, int64_t state, const float* row) {
+  if (state % 2 == 1) {
+    const int64_t k = state / 2;
+    if (k != cur_token_) {
+      finish_token();
+      cur_token_ = k;
+    }
+    const int64_t id = target(k);
+    if (id != star_id_) {
+      token_lp_ += row[id];
+      token_frames_ += 1;
+      Seg& seg = segs_[target_seg_[size_t(k - target_base_)] - seg_base_];
+      if (seg.first < 0) seg.first = frame;
+      seg.last = frame + 1;
+    }
+  } else {
+    finish_token();
+  }
+  emit_ready(state);
+}
+
+void OnlineAligner::finish_token() {
+  if (cur_token_ >= 0 && token_frames_ > 0) {
+    const size_t seg_index = target_seg_[size_t(cur_token_ - target_base_)];
+    if (seg_index >= seg_base_) {
+      const double avg = token_lp_ / double(token_frames_);
+      const double conf = std::max(0.0, std::min(1.0, 1.0 + avg / double(log_vocab_)));
+      Seg& seg = segs_[seg_index - seg_base_];
+      seg.conf_sum += conf;
+      seg.conf_n += 1;
+    }
+  }
+  cur_token_ = -1;
+  token_lp_ = 0.0;
+  token_frames_ = 0;
+}
+
+void OnlineAligner::emit_ready(int64_t state) {
+  while (!segs_.empty() && state >= 2 * segs_.front().target_end) {
+    emit(segs_.front(), seg_base_);
+    segs_.pop_front();
+    ++seg_base_;
+  }
+}
+
+void OnlineAligner::emit(Seg& seg, size_t index) {
+  OnlineSegmentResult r;
+  r.segment = index;
+  r.aligned = seg.first >= 0;
+  if (r.aligned) {
+    r.start_frame = seg.first;
+    r.end_frame = seg.last;
+    r.score = seg.conf_n ? float(seg.conf_sum / seg.conf_n) : 0.0f;
+  }
+  if (on_segment_) on_segment_(r);
+}
+
+void OnlineAligner::finish() {
+  text_closed_ = true;
+  if (!pending_.empty() && !score_.empty()) {
+    // Prefer paths that consumed every target, as forced_align() does.
+    const int64_t S = num_states();
+    const int64_t hi = lo_ + int64_t(score_.size());
+    auto score_at = [&](int64_t s) {
+      return (s >= lo_ && s < hi) ? score_[size_t(s - lo_)] : -std::numeric_limits<float>::infinity();
+    };
+    int64_t final_state = lo_ + int64_t(std::max_element(score_.begin(), score_.end()) - score_.begin());
+    const float last_blank = score_at(S - 1);
+    const float last_token = S >= 2 ? score_at(S - 2) : -std::numeric_limits<float>::infinity();
+    if (last_blank != -std::numeric_limits<float>::infinity() ||
+        last_token != -std::numeric_limits<float>::infinity()) {
+      final_state = (last_blank > last_token) ? S - 1 : S - 2;
+    }
+    commit(pending_.size() - 1, final_state, /*wait_for_text=*/false);
+  }
+  finish_token();
+  while (!segs_.empty()) {
+    emit(segs_.front(), seg_base_);
+    segs_.pop_front();
+    ++seg_base_;
+  }
+}
+
+void OnlineAligner::trim() {
+  const int64_t keep_from = std::max<int64_t>(0, commit_state_ / 2 - 1);
+  const int64_t drop = keep_from - target_base_;
+  if (drop < kTrimSlack) return;
+  targets_.erase(targets_.begin(), targets_.begin() + std::ptrdiff_t(drop));
+  target_seg_.erase(target_seg_.begin(), target_seg_.begin() + std::ptrdiff_t(drop));
+  target_base_ = keep_from;
+}
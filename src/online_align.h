@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+// Result for one appended segment, reported in append order.
+struct OnlineSegmentResult {
+  size_t segment = 0;        // index in append order
+  bool aligned = false;      // false if the stream ended before the path reached its targets
+  int64_t start_frame = 0;   // first frame spent on one of its (non-star) targets
+  int64_t end_frame = 0;     // one past the last such frame
+  float score = 0.0f;        // mean per-token confidence in [0,1], same scale as batch mode
+};
+
+// Frame-synchronous CTC Viterbi over a target sequence that grows while audio streams in.
+//
+// Emission rows are pushed one frame at a time. Back-pointers and rows are kept only for
+// frames after the last committed frame. Frames are committed once every surviving path
+// agrees on them (traceback convergence), or along the best path once they are older than
+// the latency bound. When a segment is appended, the uncommitted frames are replayed so late
+// transcript pieces can still claim them. A segment is reported as soon as the committed
+// path has moved past its last target.
+class OnlineAligner {
+ public:
+  using Callback = std::function<void(const OnlineSegmentResult&)>;
+
+  OnlineAligner(int64_t classes, int64_t blank, int64_t star_id, float log_vocab, int64_t max_latency_frames,
+                Callback on_segment);
+
+  // Append one segment's targets (may be empty).
+  void append_segment(const std::vector<int64_t>& targets);
+  // No more segments will be appended; trailing frames no longer wait for text.
+  void close_text() { text_closed_ = true; }
+  // Push one emission row (classes floats, log-probs with star column).
+  void push_frame(const float* row);
+  // End of stream: commit along the best path and report every remaining segment.
+  void finish();
+
+  int64_t frames() const { return base_frame_ + int64_t(pending_.size()); }
+  int64_t committed_frames() const { return base_frame_; }
+  size_t pending_frames() const { return pending_.size(); }
+
+ private:
+  struct Frame {
+    std::vector<float> row;     // emission row, kept for replay and scoring
+    int64_t lo = 0;             // first state with a back-pointer
+    std::vector<int8_t> bp;     // back-pointers for states [lo, lo + bp.size())
+  };
+  struct Seg {
+    int64_t target_begin = 0;  // global target index
+    int64_t target_end = 0;    // exclusive
+    int64_t first = -1;
+    int64_t last = -1;
+    double conf_sum = 0.0;
+    int conf_n = 0;
+  };
+
+  int64_t num_states() const { return 2 * num_targets_ + 1; }
+  int64_t target(int64_t k) const { return targets_[size_t(k - target_base_)]; }
+  int64_t label(int64_t s) const { return (s % 2 == 0) ? blank_ : target(s / 2); }
+  bool can_skip(int64_t s) const { return s % 2 != 0 && s != 1 && target(s / 2) != target(s / 2 - 1); }
+  int8_t back_ptr(size_t i, int64_t s) const { return pending_[i].bp[size_t(s - pending_[i].lo)]; }
+
+  void step(Frame& f);
+  void replay();
+  void try_commit();
+  void force_commit(size_t keep);
+  void commit(size_t upto, int64_t state, bool wait_for_text);
+  void consume_frame(int64_t frame, int64_t state, const float* row);
+  void finish_token();
+  void emit_ready(int64_t state);
+  void emit(Seg& seg, size_t index);
+  void trim();
+
+  int64_t classes_;
+  int64_t blank_;
+  int64_t star_id_;
+  float log_vocab_;
+  int64_t max_latency_frames_;
+  Callback on_segment_;
+  bool text_closed_ = false;
+
+  // Targets and segments; entries before *_base_ have been dropped after commit.
+  std::vector<int64_t> targets_;
+  int64_t target_base_ = 0;
+  int64_t num_targets_ = 0;
+  std::deque<Seg> segs_;
+  size_t seg_base_ = 0;
+  std::vector<size_t> target_seg_;  // parallel to targets_
+
+  // Viterbi state for the newest frame: scores for states [lo_, lo_ + score_.size()).
+  bool have_dp_ = false;
+  int64_t lo_ = 0;
+  std::vector<float> score_;
+  std::vector<float> next_;
+
+  // Commit point: every path passes through commit_state_ at frame base_frame_ - 1.
+  std::deque<Frame> pending_;
+  int64_t base_frame_ = 0;
+  int64_t commit_state_ = -1;
+
+  // Token being accumulated along the committed path.
+  int64_t cur_token_ = -1;
+  double token_lp_ = 0.0;
+  int64_t token_frames_ = 0;
+};
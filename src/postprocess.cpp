@@ -4,26 +4,43 @@
 #include <stdexcept>
 
 std::vector<WordTimestamp> postprocess_results(
-    const std::vector<std::string>& text_starred,
-    const std::vector<std::vector<SegmentSpanStr>>& spans,
+    const std::string_view* text_starred,
+    size_t num_tokens,
+    const std::vector<TokenSpan>& spans,
     int stride_ms,
-    const std::vector<float>& scores) {
-  if (text_starred.size() != spans.size()) {
+    const std::vector<float>& scores,
+    const std::vector<float>* confidence) {
+  std::vector<WordTimestamp> results;
+  postprocess_results(text_starred, num_tokens, spans, stride_ms, scores, confidence, results);
+  return results;
+}
+
+void postprocess_results(
+    const std::string_view* text_starred,
+    size_t num_tokens,
+    const std::vector<TokenSpan>& spans,
+    int stride_ms,
+    const std::vector<float>& scores,
+    const std::vector<float>* confidence,
+    std::vector<WordTimestamp>& results) {
+  if (num_tokens != spans.size()) {
     throw std::runtime_error("text_starred and spans length mismatch");
   }
+  if (confidence && confidence->size() != num_tokens) {
+    throw std::runtime_error("text_starred and confidence length mismatch");
+  }
   if (stride_ms <= 0) throw std::runtime_error("invalid stride_ms");
 
-  std::vector<WordTimestamp> results;
-  results.reserve(text_starred.size());
+  results.clear();
+  results.reserve(num_tokens);
 
-  for (size_t i = 0; i < text_starred.size(); ++i) {
-    const auto& t = text_starred[i];
+  for (size_t i = 0; i < num_tokens; ++i) {
+    const std::string_view t = text_starred[i];
     if (t == "<star>") continue;
     const auto& span = spans[i];
-    if (span.empty()) continue;
 
-    const int64_t seg_start_idx = span.front().start;
-    const int64_t seg_end_idx_incl = span.back().end;  // inclusive
+    const int64_t seg_start_idx = span.start;
+    const int64_t seg_end_idx_incl = span.end;  // inclusive
     if (seg_start_idx < 0 || seg_end_idx_incl < 0) continue;
 
     WordTimestamp w;
@@ -40,9 +57,8 @@ std::vector<WordTimestamp> postprocess_results(
       sum += scores[size_t(j)];
     }
     w.score = sum;
+    if (confidence) w.confidence = (*confidence)[i];
 
     results.push_back(std::move(w));
   }
-
-  return results;
 }
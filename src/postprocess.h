@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "span_align.h"
@@ -9,18 +10,32 @@
 struct WordTimestamp {
   double start_sec = 0.0;
   double end_sec = 0.0;
-  std::string text;
+  std::string_view text;     // text_starred entry (a view into the preprocessed text)
   float score = 0.0f;  // sum of frame log-probs over [start,end)
+  float confidence = -1.0f;  // posterior confidence in [0,1]; -1 when not computed
 };
 
 // Replicate ctc_forced_aligner.text_utils.postprocess_results
-// - text_starred: parallel to tokens_starred, includes "<star>" and original chunks
-// - spans: output of get_spans_str(tokens_starred, segments, "<blank>"), same length as tokens_starred
+// - text_starred, num_tokens: parallel to tokens_starred, includes "<star>" and original chunks
+// - spans: output of get_token_spans(), num_tokens entries
 // - stride_ms: frame stride in ms (python uses ceil(stride) but effectively 20ms)
 // - scores: per-frame log-prob for the chosen path token (length T)
+// - confidence: optional, parallel to text_starred; copied into WordTimestamp::confidence
 std::vector<WordTimestamp> postprocess_results(
-    const std::vector<std::string>& text_starred,
-    const std::vector<std::vector<SegmentSpanStr>>& spans,
+    const std::string_view* text_starred,
+    size_t num_tokens,
+    const std::vector<TokenSpan>& spans,
     int stride_ms,
-    const std::vector<float>& scores);
+    const std::vector<float>& scores,
+    const std::vector<float>* confidence = nullptr);
 
+
+// Same, writing the timestamps to `out` (cleared first) so its storage can be reused.
+void postprocess_results(
+    const std::string_view* text_starred,
+    size_t num_tokens,
+    const std::vector<TokenSpan>& spans,
+    int stride_ms,
+    const std::vector<float>& scores,
+    const std::vector<float>* confidence,
+    std::vector<WordTimestamp>& out);
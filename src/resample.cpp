@@ -0,0 +1,237 @@
+#include "resample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RESAMPLE_SSE2 1
+#else
+#define RESAMPLE_SSE2 0
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define RESAMPLE_NEON 1
+#else
+#define RESAMPLE_NEON 0
+#endif
+
+// AVX2/FMA kernel compiled via a target attribute and picked at runtime (GCC/Clang on x86).
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RESAMPLE_AVX2 1
+#else
+#define RESAMPLE_AVX2 0
+#endif
+
+namespace {
+
+constexpr uint64_t kMaxPhases = 1024;
+// Passband edge as a fraction of the lower of the two rates; the Kaiser window's transition
+// band (~1.9 kHz at 48 kHz input) then ends near the output Nyquist frequency.
+constexpr double kCutoff = 0.44;
+constexpr double kStopbandDb = 80.0;
+constexpr double kPi = 3.14159265358979323846;
+
+constexpr size_t kTaps = PolyphaseResampler::kTaps;
+static_assert(kTaps % 16 == 0, "dot kernels process 16 taps per step");
+
+double bessel_i0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 64; ++k) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if (term < sum * 1e-17) break;
+  }
+  return sum;
+}
+
+#if !RESAMPLE_SSE2 && !RESAMPLE_NEON
+float dot_scalar(const float* x, const float* c) {
+  float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+  for (size_t i = 0; i < kTaps; i += 4) {
+    s0 += x[i] * c[i];
+    s1 += x[i + 1] * c[i + 1];
+    s2 += x[i + 2] * c[i + 2];
+    s3 += x[i + 3] * c[i + 3];
+  }
+  return (s0 + s1) + (s2 + s3);
+}
+#endif
+
+#if RESAMPLE_SSE2
+float dot_sse2(const float* x, const float* c) {
+  __m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps(), a2 = _mm_setzero_ps(), a3 = _mm_setzero_ps();
+  for (size_t i = 0; i < kTaps; i += 16) {
+    a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(c + i)));
+    a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(c + i + 4)));
+    a2 = _mm_add_ps(a2, _mm_mul_ps(_mm_loadu_ps(x + i + 8), _mm_loadu_ps(c + i + 8)));
+    a3 = _mm_add_ps(a3, _mm_mul_ps(_mm_loadu_ps(x + i + 12), _mm_loadu_ps(c + i + 12)));
+  }
+  const __m128 s = _mm_add_ps(_mm_add_ps(a0, a1), _mm_add_ps(a2, a3));
+  const __m128 h = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  return _mm_cvtss_f32(_mm_add_ss(h, _mm_shuffle_ps(h, h, 1)));
+}
+#endif
+
+#if RESAMPLE_NEON
+float dot_neon(const float* x, const float* c) {
+  float32x4_t a0 = vdupq_n_f32(0.0f), a1 = a0, a2 = a0, a3 = a0;
+  for (size_t i = 0; i < kTaps; i += 16) {
+    a0 = vmlaq_f32(a0, vld1q_f32(x + i), vld1q_f32(c + i));
+    a1 = vmlaq_f32(a1, vld1q_f32(x + i + 4), vld1q_f32(c + i + 4));
+    a2 = vmlaq_f32(a2, vld1q_f32(x + i + 8), vld1q_f32(c + i + 8));
+    a3 = vmlaq_f32(a3, vld1q_f32(x + i + 12), vld1q_f32(c + i + 12));
+  }
+  const float32x4_t s = vaddq_f32(vaddq_f32(a0, a1), vaddq_f32(a2, a3));
+  const float32x2_t h = vadd_f32(vget_low_f32(s), vget_high_f32(s));
+  return vget_lane_f32(vpadd_f32(h, h), 0);
+}
+#endif
+
+#if RESAMPLE_AVX2
+__attribute__((target("avx2,fma"))) float dot_avx2(const float* x, const float* c) {
+  __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+  for (size_t i = 0; i < kTaps; i += 16) {
+    a0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(c + i), a0);
+    a1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(c + i + 8), a1);
+  }
+  const __m256 s8 = _mm256_add_ps(a0, a1);
+  const __m128 s = _mm_add_ps(_mm256_castps256_ps128(s8), _mm256_extractf128_ps(s8, 1));
+  const __m128 h = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  return _mm_cvtss_f32(_mm_add_ss(h, _mm_shuffle_ps(h, h, 1)));
+}
+#endif
+
+using DotFn = float (*)(const float*, const float*);
+
+DotFn select_dot() {
+#if RESAMPLE_AVX2
+  __builtin_cpu_init();  // runs during static initialization, possibly before libgcc's
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return dot_avx2;
+#endif
+#if RESAMPLE_SSE2
+  return dot_sse2;
+#elif RESAMPLE_NEON
+  return dot_neon;
+#else
+  return dot_scalar;
+#endif
+}
+
+const DotFn g_dot = select_dot();
+
+}  // namespace
+
+bool PolyphaseResampler::supported(uint32_t in_rate, uint32_t out_rate) {
+  return in_rate > 0 && out_rate > 0 && out_rate / std::gcd(in_rate, out_rate) <= kMaxPhases;
+}
+
+PolyphaseResampler::PolyphaseResampler(uint32_t in_rate, uint32_t out_rate) : in_rate_(in_rate), out_rate_(out_rate) {
+  if (!supported(in_rate, out_rate)) {
+    throw std::runtime_error("Unsupported resampling ratio: " + std::to_string(in_rate) + " -> " +
+                             std::to_string(out_rate) + " Hz");
+  }
+  const uint64_t g = std::gcd<uint64_t>(in_rate, out_rate);
+  up_ = out_rate / g;
+  down_ = in_rate / g;
+
+  // Prototype low-pass at the upsampled rate (up_ * in_rate), centered on tap `center`.
+  const size_t length = kTaps * size_t(up_);
+  const double center = double(length / 2);
+  const double fc = kCutoff * std::min(in_rate, out_rate) / (double(up_) * in_rate);
+  const double beta = 0.1102 * (kStopbandDb - 8.7);
+  const double i0_beta = bessel_i0(beta);
+  std::vector<double> proto(length);
+  for (size_t j = 0; j < length; ++j) {
+    const double t = double(j) - center;
+    const double arg = 2.0 * fc * t;
+    const double sinc = t == 0.0 ? 1.0 : std::sin(kPi * arg) / (kPi * arg);
+    const double r = t / center;
+    const double window = bessel_i0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / i0_beta;
+    proto[j] = 2.0 * fc * sinc * window;
+  }
+
+  // Split into phases, reversed to run over ascending input frames, each normalized to unit
+  // DC gain.
+  coeffs_.resize(length);
+  for (size_t p = 0; p < up_; ++p) {
+    double sum = 0.0;
+    for (size_t m = 0; m < kTaps; ++m) sum += proto[p + (kTaps - 1 - m) * up_];
+    for (size_t m = 0; m < kTaps; ++m) coeffs_[p * kTaps + m] = float(proto[p + (kTaps - 1 - m) * up_] / sum);
+  }
+}
+
+uint64_t PolyphaseResampler::output_frames(uint64_t in_frames) const {
+  return (in_frames * up_ + down_ - 1) / down_;
+}
+
+void PolyphaseResampler::input_window(uint64_t out_begin, uint64_t out_end, int64_t& first, int64_t& last) const {
+  const uint64_t center = kTaps * up_ / 2;
+  first = int64_t((out_begin * down_ + center) / up_) - int64_t(kTaps - 1);
+  if (out_end <= out_begin) {
+    last = first;
+    return;
+  }
+  last = int64_t(((out_end - 1) * down_ + center) / up_) + 1;
+}
+
+void PolyphaseResampler::process(const float* in, int64_t in_offset, size_t in_count, uint64_t total_in,
+                                 uint64_t out_begin, size_t count, float* out) const {
+  // Output n reads phase (n * M + center) % L and the kTaps frames ending at
+  // (n * M + center) / L; both advance by fixed steps per output frame.
+  const uint64_t center = kTaps * up_ / 2;
+  const uint64_t t = out_begin * down_ + center;
+  uint64_t phase = t % up_;
+  int64_t first = int64_t(t / up_) - int64_t(kTaps - 1);
+  const uint64_t step_frames = down_ / up_;
+  const uint64_t step_phase = down_ % up_;
+
+  const int64_t buf_end = in_offset + int64_t(in_count);
+  const int64_t valid_begin = std::max<int64_t>(in_offset, 0);
+  const int64_t valid_end = total_in < uint64_t(std::max<int64_t>(buf_end, 0)) ? int64_t(total_in) : buf_end;
+  float window[kTaps];
+  for (size_t n = 0; n < count; ++n) {
+    const float* c = coeffs_.data() + phase * kTaps;
+    if (first >= in_offset && first + int64_t(kTaps) <= buf_end) {
+      out[n] = g_dot(in + (first - in_offset), c);
+    } else {
+      // Stream edges: frames outside the stream are silence.
+      for (size_t m = 0; m < kTaps; ++m) {
+        const int64_t i = first + int64_t(m);
+        window[m] = i >= valid_begin && i < valid_end ? in[i - in_offset] : 0.0f;
+      }
+      out[n] = g_dot(window, c);
+    }
+    phase += step_phase;
+    first += int64_t(step_frames);
+    if (phase >= up_) {
+      phase -= up_;
+      ++first;
+    }
+  }
+}
+
+void downmix_to_mono(const float* interleaved, size_t frames, uint32_t channels, float* out) {
+  if (channels == 1) {
+    std::memcpy(out, interleaved, frames * sizeof(float));
+    return;
+  }
+  if (channels == 2) {
+    for (size_t i = 0; i < frames; ++i) out[i] = (interleaved[2 * i] + interleaved[2 * i + 1]) * 0.5f;
+    return;
+  }
+  const float scale = 1.0f / float(channels);
+  for (size_t i = 0; i < frames; ++i) {
+    const float* frame = interleaved + i * channels;
+    float sum = 0.0f;
+    for (uint32_t ch = 0; ch < channels; ++ch) sum += frame[ch];
+    out[i] = sum * scale;
+  }
+}
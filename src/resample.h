@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Polyphase FIR resampler for mono float audio (Kaiser-windowed sinc low-pass, 128 taps per
+// phase, cutoff 0.44 x output rate). Output frame n sits exactly at input time
+// n * in_rate / out_rate (no delay), and depends only on the input frames around it, so any
+// range of output frames can be computed on its own from the input window it covers.
+// Input frames outside [0, total_in) count as silence.
+class PolyphaseResampler {
+ public:
+  static constexpr size_t kTaps = 128;  // per phase
+
+  // Throws std::runtime_error unless supported(in_rate, out_rate).
+  PolyphaseResampler(uint32_t in_rate, uint32_t out_rate);
+
+  // False for zero rates and for ratios needing more than 1024 filter phases.
+  static bool supported(uint32_t in_rate, uint32_t out_rate);
+
+  uint32_t in_rate() const { return in_rate_; }
+  uint32_t out_rate() const { return out_rate_; }
+
+  // Output frames produced from `in_frames` input frames: those whose time lies before the end.
+  uint64_t output_frames(uint64_t in_frames) const;
+
+  // Input frames [first, last) read by output frames [out_begin, out_end); may extend past
+  // either end of the stream.
+  void input_window(uint64_t out_begin, uint64_t out_end, int64_t& first, int64_t& last) const;
+
+  // Writes output frames [out_begin, out_begin + count) to `out`. `in` holds input frames
+  // [in_offset, in_offset + in_count), which must include every frame of the window that lies
+  // inside [0, total_in).
+  void process(const float* in, int64_t in_offset, size_t in_count, uint64_t total_in, uint64_t out_begin,
+               size_t count, float* out) const;
+
+ private:
+  uint32_t in_rate_;
+  uint32_t out_rate_;
+  uint64_t up_;    // L: out_rate / gcd
+  uint64_t down_;  // M: in_rate / gcd
+  // Phase p's taps, ordered to match ascending input frames: coeffs_[p * kTaps + m].
+  std::vector<float> coeffs_;
+};
+
+// Average of the channels of each interleaved frame.
+void downmix_to_mono(const float* interleaved, size_t frames, uint32_t channels, float* out);
@@ -0,0 +1,447 @@
+#include "serve.h"
+
+#include "audio_decode.h"
+#include "batch_align.h"
+#include "bounded_queue.h"
+#include "emissions.h"
+#include "json_io.h"
+#include "srt_io.h"
+#include "text_preprocess.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+
+// Jobs that may wait per worker before input reading pauses.
+constexpr size_t kQueuedJobsPerWorker = 2;
+// A socket client that takes no reply data for this long is dropped, so it cannot hold a worker.
+constexpr int kReplyTimeoutSeconds = 10;
+// Pause before accepting again when the process or system is out of descriptors or memory.
+constexpr int kAcceptBackoffMs = 100;
+
+// Reply stream of one client (stdout, or a socket connection closed with the last reference).
+// Lines from concurrent jobs are written whole.
+class ReplyChannel {
+ public:
+  explicit ReplyChannel(int fd = -1) : fd_(fd) {
+#ifndef _WIN32
+    if (fd_ >= 0) {
+      timeval timeout{};
+      timeout.tv_sec = kReplyTimeoutSeconds;
+      ::setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    }
+#endif
+  }
+  ReplyChannel(const ReplyChannel&) = delete;
+  ReplyChannel& operator=(const ReplyChannel&) = delete;
+  ~ReplyChannel() {
+#ifndef _WIN32
+    if (fd_ >= 0) ::close(fd_);
+#endif
+  }
+
+  void write_line(const std::string& line) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ < 0) {
+      std::cout << line << "\n";
+      std::cout.flush();
+      return;
+    }
+#ifndef _WIN32
+    // A client that went away, or stopped reading, loses this and all later replies.
+    if (broken_) return;
+    const std::string data = line + "\n";
+    size_t sent = 0;
+    while (sent < data.size()) {
+      const ssize_t n = ::write(fd_, data.data() + sent, data.size() - sent);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) {
+        broken_ = true;
+        ::shutdown(fd_, SHUT_RDWR);  // also ends the connection's reader
+        return;
+      }
+      sent += size_t(n);
+    }
+#endif
+  }
+
+#ifndef _WIN32
+  // Wakes a reader blocked on the connection; later reads see end of input.
+  void shutdown() { ::shutdown(fd_, SHUT_RDWR); }
+#endif
+
+ private:
+  int fd_;  // -1: stdout
+  std::mutex mutex_;
+  bool broken_ = false;
+};
+
+struct Job {
+  std::string line;
+  std::shared_ptr<ReplyChannel> reply;
+};
+
+struct ServerContext {
+  const CliArgs& args;
+  Ort::Session& session;
+  const Vocab& vocab;
+  const ModelConfig& model_config;
+  Logger& log;
+  int align_threads;  // per job, so that concurrent jobs share the cores
+  std::atomic<uint64_t> served{0};
+  std::atomic<uint64_t> failed{0};
+};
+
+std::string decode_base64(const std::string& text) {
+  auto value = [](char c) -> int {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+  };
+  std::string out;
+  out.reserve(text.size() / 4 * 3);
+  uint32_t bits = 0;
+  int nbits = 0;
+  for (char c : text) {
+    if (c == '=') break;
+    if (c == '\n' || c == '\r') continue;
+    const int v = value(c);
+    if (v < 0) throw std::runtime_error("\"pcm\" is not valid base64");
+    bits = (bits << 6) | uint32_t(v);
+    nbits += 6;
+    if (nbits >= 8) {
+      nbits -= 8;
+      out.push_back(char((bits >> nbits) & 0xFF));
+    }
+  }
+  return out;
+}
+
+std::string job_pcm_format(const json& job, const CliArgs& args) {
+  const std::string format = job.value("pcm_format", args.pcm_format);
+  if (format != "s16le" && format != "f32le") throw std::runtime_error("\"pcm_format\" must be 's16le' or 'f32le'");
+  return format;
+}
+
+AudioSamples job_audio(const json& job, const CliArgs& args) {
+  if (job.contains("pcm")) {
+    const std::string bytes = decode_base64(job["pcm"].get<std::string>());
+    const bool f32 = job_pcm_format(job, args) == "f32le";
+    const size_t sample_bytes = f32 ? 4 : 2;
+    std::vector<float> samples(bytes.size() / sample_bytes);
+    for (size_t i = 0; i < samples.size(); ++i) {
+      if (f32) {
+        std::memcpy(&samples[i], bytes.data() + i * 4, 4);
+      } else {
+        int16_t v;
+        std::memcpy(&v, bytes.data() + i * 2, 2);
+        samples[i] = float(v) / 32768.0f;
+      }
+    }
+    return AudioSamples(std::move(samples));
+  }
+  if (!job.contains("audio")) throw std::runtime_error("job needs \"audio\" (a path) or \"pcm\"");
+
+  const fs::path path = job["audio"].get<std::string>();
+  if (path.string() == "-") throw std::runtime_error("\"audio\" must be a file path");
+  AudioInput input;
+  const std::string resampler = job.value("resampler", args.resampler);
+  if (resampler != "linear" && resampler != "polyphase") {
+    throw std::runtime_error("\"resampler\" must be 'linear' or 'polyphase'");
+  }
+  input.resampler = resampler == "polyphase" ? Resampler::Polyphase : Resampler::Linear;
+  const std::string ext = path.extension().string();
+  input.raw = job.contains("pcm_format") || ext == ".raw" || ext == ".pcm" || ext == ".RAW" || ext == ".PCM";
+  input.pcm_format = job_pcm_format(job, args) == "f32le" ? PcmFormat::F32LE : PcmFormat::S16LE;
+  return load_audio_16k_mono(path, input);
+}
+
+std::vector<SrtSegment> job_segments(const json& job) {
+  if (job.contains("segments")) return parse_json_input(job["segments"].dump());
+  if (job.contains("srt")) return read_srt_utf8(job["srt"].get<std::string>());
+  throw std::runtime_error("job needs \"segments\" or \"srt\"");
+}
+
+// Runs one job line and returns its reply line; job errors become {"ok": false} replies.
+std::string run_job(ServerContext& ctx, const std::string& line) {
+  using clock = std::chrono::steady_clock;
+  const auto t0 = clock::now();
+  json reply;
+  reply["id"] = nullptr;
+  try {
+    const json job = json::parse(line);
+    if (!job.is_object()) throw std::runtime_error("job must be a JSON object");
+    if (job.contains("id")) reply["id"] = job["id"];
+
+    PreprocessConfig prep_config;
+    prep_config.language = job.value("language", ctx.args.language);
+    const bool romanize = job.value("romanize", ctx.args.romanize);
+    if (romanize && !ctx.args.romanize && ctx.model_config.requires_romanization) {
+      throw std::runtime_error("\"romanize\" needs the server started with --romanize (loads the pinyin table)");
+    }
+    prep_config.romanize = ctx.model_config.requires_romanization && romanize;
+    const std::string confidence = job.value("confidence", ctx.args.confidence);
+    if (confidence != "viterbi" && confidence != "posterior") {
+      throw std::runtime_error("\"confidence\" must be 'viterbi' or 'posterior'");
+    }
+
+    auto segments = job_segments(job);
+    const AudioSamples audio = job_audio(job, ctx.args);
+    const auto emissions = generate_emissions_ort(
+        ctx.session, audio.data(), audio.size(), /*window_seconds=*/30, /*context_seconds=*/2,
+        /*batch_size=*/ctx.args.batch_size, /*star_logp=*/0.0f);
+    if (emissions.classes != ctx.vocab.star_id + 1) {
+      throw std::runtime_error(
+          "vocab size mismatch: emissions classes=" + std::to_string(emissions.classes) + ", vocab+star=" +
+          std::to_string(ctx.vocab.star_id + 1) + " (check matching model + vocab file)");
+    }
+    align_segments(segments, emissions.log_probs.data(), emissions.frames, emissions.classes, emissions.stride_ms,
+                   ctx.vocab, prep_config, ctx.model_config, confidence == "posterior", ctx.align_threads, ctx.log);
+
+    json out = json::array();
+    for (const auto& seg : segments) {
+      out.push_back({{"index", seg.index}, {"start", seg.start_sec}, {"end", seg.end_sec}, {"text", seg.text},
+                     {"score", seg.score}});
+    }
+    reply["ok"] = true;
+    reply["segments"] = std::move(out);
+    reply["audio_duration"] = double(audio.size()) / 16000.0;
+    reply["processing_time"] = std::chrono::duration<double>(clock::now() - t0).count();
+    ++ctx.served;
+    std::ostringstream ss;
+    ss << "[serve] job " << reply["id"].dump() << ": " << segments.size() << " segments, "
+       << reply["audio_duration"].get<double>() << " s audio, "
+       << int64_t(reply["processing_time"].get<double>() * 1000) << " ms";
+    ctx.log.info(ss.str());
+  } catch (const std::exception& e) {
+    reply["ok"] = false;
+    reply["error"] = e.what();
+    ++ctx.failed;
+    ctx.log.warn("[serve] job " + reply["id"].dump() + " failed: " + e.what());
+  }
+  return reply.dump();
+}
+
+// Queues each non-blank line of `in`; returns at end of input or once the queue is closed.
+void queue_lines(std::istream& in, const std::shared_ptr<ReplyChannel>& reply, BoundedQueue<Job>& queue) {
+  std::string line;
+  while (std::getline(in, line)) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.find_first_not_of(" \t") == std::string::npos) continue;
+    if (!queue.push(Job{std::move(line), reply})) return;
+  }
+}
+
+#ifndef _WIN32
+// Same as queue_lines() for one socket connection; the connection closes once its last reply
+// has been written.
+void queue_connection(int fd, const std::shared_ptr<ReplyChannel>& reply, BoundedQueue<Job>& queue) {
+  std::string pending;
+  char buf[65536];
+  auto push_line = [&](std::string line) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.find_first_not_of(" \t") == std::string::npos) return true;
+    return queue.push(Job{std::move(line), reply});
+  };
+  for (;;) {
+    const ssize_t n = ::read(fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    pending.append(buf, size_t(n));
+    size_t start = 0;
+    for (size_t nl; (nl = pending.find('\n', start)) != std::string::npos; start = nl + 1) {
+      if (!push_line(pending.substr(start, nl - start))) return;
+    }
+    pending.erase(0, start);
+  }
+  push_line(std::move(pending));
+}
+
+// Reader threads of the open socket connections. Each entry keeps its connection open, so
+// stop() can wake a reader blocked on it however far its jobs have got.
+class Connections {
+ public:
+  Connections() = default;
+  Connections(const Connections&) = delete;
+  Connections& operator=(const Connections&) = delete;
+  ~Connections() { stop(); }
+
+  void start(int fd, BoundedQueue<Job>& queue) {
+    reap();
+    Connection c;
+    c.reply = std::make_shared<ReplyChannel>(fd);
+    c.done = std::make_shared<std::atomic<bool>>(false);
+    c.thread = std::thread([fd, reply = c.reply, done = c.done, &queue] {
+      queue_connection(fd, reply, queue);
+      *done = true;
+    });
+    open_.push_back(std::move(c));
+  }
+
+  // Ends every connection's reading; the caller closes the queue so blocked pushes return.
+  void stop() {
+    for (auto& c : open_) c.reply->shutdown();
+    for (auto& c : open_) c.thread.join();
+    open_.clear();
+  }
+
+  // Joins readers that reached the end of their connection and drops this list's hold on the
+  // connection, which closes once its replies are written.
+  void reap() {
+    auto finished = std::partition(open_.begin(), open_.end(), [](const Connection& c) { return !*c.done; });
+    for (auto it = finished; it != open_.end(); ++it) it->thread.join();
+    open_.erase(finished, open_.end());
+  }
+
+ private:
+  struct Connection {
+    std::thread thread;
+    std::shared_ptr<ReplyChannel> reply;
+    std::shared_ptr<std::atomic<bool>> done;
+  };
+
+  std::vector<Connection> open_;
+};
+
+// Accepts clients on the Unix socket `path` until an error; each connection is read on its own
+// thread. Running out of descriptors, memory or threads only pauses accepting or drops that
+// client. Before an error is thrown, all connections are shut down, the queue is closed and
+// their readers are joined.
+void serve_socket(const fs::path& path, BoundedQueue<Job>& queue, Logger& log) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  const std::string name = path.string();
+  if (name.size() >= sizeof(addr.sun_path)) throw std::runtime_error("Socket path too long: " + name);
+  std::memcpy(addr.sun_path, name.c_str(), name.size() + 1);
+
+  std::error_code ec;
+  if (fs::is_socket(path, ec)) {
+    fs::remove(path, ec);  // left behind by an earlier server
+  } else if (fs::exists(path, ec)) {
+    throw std::runtime_error("Refusing to replace non-socket file: " + name);
+  }
+
+  const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) throw std::runtime_error(std::string("socket() failed: ") + std::strerror(errno));
+  if (::bind(listener, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listener, 16) != 0) {
+    const std::string err = std::strerror(errno);
+    ::close(listener);
+    throw std::runtime_error("Failed to listen on " + name + ": " + err);
+  }
+  std::signal(SIGPIPE, SIG_IGN);  // replies to a closed connection must not kill the server
+  log.info("[serve] listening on " + name);
+
+  Connections connections;
+  auto stop = [&] {
+    ::close(listener);
+    queue.close();
+    connections.stop();
+  };
+  bool backing_off = false;  // warned about the current shortage already
+  try {
+    for (;;) {
+      const int fd = ::accept(listener, nullptr, nullptr);
+      if (fd < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) continue;
+        if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+          if (!backing_off) log.warn(std::string("[serve] accept() failed, retrying: ") + std::strerror(errno));
+          backing_off = true;
+          std::this_thread::sleep_for(std::chrono::milliseconds(kAcceptBackoffMs));
+          connections.reap();
+          continue;
+        }
+        throw std::runtime_error("accept() failed on " + name + ": " + std::strerror(errno));
+      }
+      backing_off = false;
+      try {
+        connections.start(fd, queue);
+      } catch (const std::system_error& e) {
+        log.warn(std::string("[serve] dropping a client, no thread for it: ") + e.what());
+      }
+    }
+  } catch (...) {
+    stop();
+    throw;
+  }
+}
+#endif
+
+}  // namespace
+
+int run_server(
+    const CliArgs& args,
+    Ort::Session& session,
+    const Vocab& vocab,
+    const ModelConfig& model_config,
+    Logger& log) {
+#ifdef _WIN32
+  if (!args.socket.empty()) throw std::runtime_error("--socket is not supported on Windows; use stdin/stdout");
+#endif
+  const size_t workers_count = size_t(args.serve_jobs);
+  const int align_threads = std::max(1, int(std::thread::hardware_concurrency()) / int(workers_count));
+  ServerContext ctx{args, session, vocab, model_config, log, align_threads};
+  BoundedQueue<Job> queue(workers_count * kQueuedJobsPerWorker);
+
+  // ORT sessions accept concurrent Run() calls, so the workers share one.
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < workers_count; ++i) {
+    workers.emplace_back([&] {
+      while (auto job = queue.pop()) job->reply->write_line(run_job(ctx, job->line));
+    });
+  }
+  auto stop_workers = [&] {
+    queue.close();
+    for (auto& w : workers) w.join();
+  };
+
+  try {
+#ifndef _WIN32
+    if (!args.socket.empty()) {
+      serve_socket(args.socket, queue, log);
+    } else
+#endif
+    {
+      queue_lines(std::cin, std::make_shared<ReplyChannel>(), queue);
+    }
+  } catch (...) {
+    stop_workers();
+    throw;
+  }
+  stop_workers();
+
+  std::ostringstream ss;
+  ss << "[serve] " << ctx.served.load() << " jobs aligned, " << ctx.failed.load() << " failed";
+  log.info(ss.str());
+  return 0;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+
+#include "cli_args.h"
+#include "logger.h"
+#include "model_config.h"
+#include "vocab.h"
+
+// Server mode (--serve).
+// Keeps the session, vocab and pinyin table loaded and aligns JSON-lines jobs read from stdin
+// (replies on stdout) or from clients of the Unix socket --socket. A job is one object:
+//   {"id": any, "audio": path | "pcm": base64 16 kHz mono PCM, "segments": [...] | "srt": path,
+//    optional "language", "romanize", "confidence", "resampler", "pcm_format"}
+// and is answered with one line, {"id", "ok": true, "segments", "audio_duration",
+// "processing_time"} or {"id", "ok": false, "error"}, in completion order. Up to --jobs jobs run
+// at once; further jobs wait in a bounded queue, which stops reading input while it is full.
+// Options a job leaves out default to the server's command line.
+int run_server(
+    const CliArgs& args,
+    Ort::Session& session,
+    const Vocab& vocab,
+    const ModelConfig& model_config,
+    Logger& log);
@@ -1,30 +1,54 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <string>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
-struct SegmentStr {
-  std::string label;
-  int64_t start = 0;  // inclusive
-  int64_t end = 0;    // inclusive (match python merge_repeats output)
+// Frame range of one token. Both ends are inclusive: ctc_forced_aligner keeps Segment.end
+// inclusive, and postprocess_results uses span[-1].end directly for score slicing and time.
+struct TokenSpan {
+  int64_t start = 0;
+  int64_t end = 0;
 };
 
-struct SegmentSpanStr {
-  std::string label;
-  int64_t start = 0;  // inclusive
-  int64_t end = 0;    // exclusive
-};
-
-// Merge repeats on a token path (T) but map token ids to string labels.
-std::vector<SegmentStr> merge_repeats_str(
+// Replicate ctc_forced_aligner merge_repeats + get_spans(tokens, segments, blank) on token ids.
+// - path: per-frame label ids from forced_align (length T)
+// - targets/token_offsets: token i owns targets[token_offsets[i], token_offsets[i + 1]);
+//   token_offsets has num_tokens + 1 entries (see PreprocessResult)
+// - blank_id: id of the blank label
+// Returns one span per token reached by the path, in token order, with blank padding on
+// both sides as get_spans adds it. Throws if the path disagrees with the targets.
+std::vector<TokenSpan> get_token_spans(
     const std::vector<int64_t>& path,
-    const std::unordered_map<int64_t, std::string>& idx_to_token);
+    const int64_t* targets,
+    const size_t* token_offsets,
+    size_t num_tokens,
+    int64_t blank_id);
 
-// Replicate ctc_forced_aligner.get_spans(tokens, segments, blank_label_string)
-std::vector<std::vector<SegmentSpanStr>> get_spans_str(
-    const std::vector<std::string>& tokens_starred,
-    const std::vector<SegmentStr>& segments,
-    const std::string& blank_label);
+// Scratch buffers of get_token_spans(), reusable across calls.
+struct SpanWorkspace {
+  // One run of equal labels in the path (merge_repeats output); end is inclusive.
+  struct Run {
+    int64_t label;
+    int64_t start;
+    int64_t end;
+  };
+  std::vector<Run> runs;
+  std::vector<std::pair<size_t, size_t>> intervals;  // first/last run of each token
 
+  // Bytes currently reserved by the buffers.
+  size_t bytes() const {
+    return runs.capacity() * sizeof(Run) + intervals.capacity() * sizeof(std::pair<size_t, size_t>);
+  }
+};
+
+// Same, writing the spans to `out` and using `ws` for scratch space.
+void get_token_spans(
+    const std::vector<int64_t>& path,
+    const int64_t* targets,
+    const size_t* token_offsets,
+    size_t num_tokens,
+    int64_t blank_id,
+    std::vector<TokenSpan>& out,
+    SpanWorkspace& ws);
@@ -1,10 +1,47 @@
 #include "srt_io.h"
 
+#include <cctype>
 #include <fstream>
-#include <regex>
 #include <sstream>
 #include <stdexcept>
 
+// Hand-written matchers for the SRT line shapes; \s and \d below mean ASCII whitespace and digits.
+
+// ^\d+$
+static bool is_index_line(const std::string& line) {
+  if (line.empty()) return false;
+  for (char c : line) {
+    if (c < '0' || c > '9') return false;
+  }
+  return true;
+}
+
+// ^\{score:\s*-?[\d.]+\}$ (score comments written by a previous run)
+static bool is_score_line(const std::string& line) {
+  static const char kPrefix[] = "{score:";
+  const size_t prefix_len = sizeof(kPrefix) - 1;
+  if (line.size() < prefix_len + 2 || line.compare(0, prefix_len, kPrefix) != 0 || line.back() != '}') return false;
+  size_t i = prefix_len;
+  const size_t end = line.size() - 1;
+  while (i < end && std::isspace(static_cast<unsigned char>(line[i]))) ++i;
+  if (i < end && line[i] == '-') ++i;
+  if (i == end) return false;
+  for (; i < end; ++i) {
+    if (!((line[i] >= '0' && line[i] <= '9') || line[i] == '.')) return false;
+  }
+  return true;
+}
+
+// Drops every \s byte ("00:00:05, 440 " -> "00:00:05,440").
+static std::string strip_whitespace(const std::string& s) {
+  std::string out;
+  out.reserve(s.size());
+  for (char c : s) {
+    if (!std::isspace(static_cast<unsigned char>(c))) out.push_back(c);
+  }
+  return out;
+}
+
 static double parse_srt_time(const std::string& s) {
   // "00:00:05,440"
   int hh = 0, mm = 0, ss = 0, ms = 0;
@@ -44,10 +81,9 @@ std::vector<SrtSegment> read_srt_utf8(const std::filesystem::path& path) {
   std::vector<SrtSegment> segs;
   std::stringstream ss(content);
   std::string line;
-  std::regex idx_re(R"(^\d+$)");
   while (std::getline(ss, line)) {
     if (line.size() && line.back() == '\r') line.pop_back();
-    if (!std::regex_match(line, idx_re)) continue;
+    if (!is_index_line(line)) continue;
     const int index = std::stoi(line);
     if (!std::getline(ss, line)) break;
     if (line.size() && line.back() == '\r') line.pop_back();
@@ -55,17 +91,16 @@ std::vector<SrtSegment> read_srt_utf8(const std::filesystem::path& path) {
     if (arrow == std::string::npos) continue;
     const auto a = line.substr(0, arrow);
     const auto b = line.substr(arrow + 3);
-    const double start = parse_srt_time(std::regex_replace(a, std::regex(R"(\s+)"), ""));
-    const double end = parse_srt_time(std::regex_replace(b, std::regex(R"(\s+)"), ""));
+    const double start = parse_srt_time(strip_whitespace(a));
+    const double end = parse_srt_time(strip_whitespace(b));
 
     std::string text;
     bool first = true;
-    std::regex score_re(R"(^\{score:\s*-?[\d.]+\}$)");
     while (std::getline(ss, line)) {
       if (line.size() && line.back() == '\r') line.pop_back();
       if (line.empty()) break;
       // Skip score lines from previous runs
-      if (std::regex_match(line, score_re)) continue;
+      if (is_score_line(line)) continue;
       if (!first) text.push_back('\n');
       first = false;
       text += line;
@@ -85,8 +120,11 @@ void write_srt_utf8(const std::filesystem::path& path, const std::vector<SrtSegm
     f << format_srt_time(s.start_sec) << " --> " << format_srt_time(s.end_sec) << "\n";
     f << s.text << "\n";
     // Output confidence score as a comment (score: X.XXX)
-    char score_buf[32];
-    std::snprintf(score_buf, sizeof(score_buf), "%.3f", s.score);
-    f << "{score: " << score_buf << "}\n\n";
+    if (s.has_score) {
+      char score_buf[32];
+      std::snprintf(score_buf, sizeof(score_buf), "%.3f", s.score);
+      f << "{score: " << score_buf << "}\n";
+    }
+    f << "\n";
   }
 }
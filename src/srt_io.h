@@ -10,6 +10,7 @@ struct SrtSegment {
   double end_sec = 0.0;
   std::string text;
   float score = 0.0f;  // alignment confidence score
+  bool has_score = true;  // false: written without a score (a segment the run left untouched)
 };
 
 std::vector<SrtSegment> read_srt_utf8(const std::filesystem::path& path);
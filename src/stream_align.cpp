@@ -0,0 +1,350 @@
+#include "stream_align.h"
+
+#include "bounded_queue.h"
+#include "emissions.h"
+#include "json_io.h"
+#include "online_align.h"
+#include "srt_io.h"
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <io.h>
+#include <windows.h>
+#else
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// One input of the stream (a file, FIFO or stdin), read on its own thread. cancel() makes a read
+// that is blocked on a pipe or terminal return as end of input, so the thread can be joined.
+class StreamInput {
+ public:
+  StreamInput(const fs::path& path, const std::string& what) {
+    if (path.string() == "-") {
+      fd_ = 0;
+#ifdef _WIN32
+      _setmode(fd_, _O_BINARY);
+#endif
+    } else {
+#ifdef _WIN32
+      fd_ = _wopen(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+      fd_ = ::open(path.c_str(), O_RDONLY);
+#endif
+      if (fd_ < 0) throw std::runtime_error("Failed to open " + what + ": " + path.string());
+      owned_ = true;
+    }
+#ifndef _WIN32
+    if (::pipe(wake_) != 0) {
+      const std::string err = std::strerror(errno);
+      if (owned_) ::close(fd_);
+      throw std::runtime_error("pipe() failed: " + err);
+    }
+    ::fcntl(wake_[1], F_SETFL, O_NONBLOCK);
+#endif
+  }
+  StreamInput(const StreamInput&) = delete;
+  StreamInput& operator=(const StreamInput&) = delete;
+  ~StreamInput() {
+#ifdef _WIN32
+    if (owned_) _close(fd_);
+#else
+    if (owned_) ::close(fd_);
+    ::close(wake_[0]);
+    ::close(wake_[1]);
+#endif
+  }
+
+  // Up to n bytes; 0 at end of input or once cancel() was called.
+  size_t read(char* buf, size_t n) {
+    for (;;) {
+      if (cancelled_) return 0;
+#ifdef _WIN32
+      const int got = _read(fd_, buf, unsigned(n));
+      if (got >= 0) return size_t(got);
+      if (cancelled_) return 0;
+      throw std::runtime_error("stream read failed");
+#else
+      pollfd fds[2] = {{fd_, POLLIN, 0}, {wake_[0], POLLIN, 0}};
+      if (::poll(fds, 2, -1) < 0) {
+        if (errno == EINTR) continue;
+        throw std::runtime_error(std::string("poll() failed: ") + std::strerror(errno));
+      }
+      if (fds[1].revents) return 0;
+      const ssize_t got = ::read(fd_, buf, n);
+      if (got >= 0) return size_t(got);
+      if (errno == EINTR || errno == EAGAIN) continue;
+      throw std::runtime_error(std::string("stream read failed: ") + std::strerror(errno));
+#endif
+    }
+  }
+
+  // Safe to call from any thread, repeatedly. On Windows a read that starts just after the call
+  // is not interrupted, so the caller repeats it until the reader has returned.
+  void cancel() {
+    cancelled_ = true;
+#ifdef _WIN32
+    CancelIoEx(reinterpret_cast<HANDLE>(_get_osfhandle(fd_)), nullptr);
+#else
+    const char byte = 0;
+    if (::write(wake_[1], &byte, 1) < 0) {
+      // The pipe is full, so a wake-up is already pending.
+    }
+#endif
+  }
+
+ private:
+  int fd_ = -1;
+  bool owned_ = false;
+  std::atomic<bool> cancelled_{false};
+#ifndef _WIN32
+  int wake_[2] = {-1, -1};
+#endif
+};
+
+struct StreamEvent {
+  enum class Kind { Audio, AudioEnd, Text, TextEnd };
+  Kind kind = Kind::Audio;
+  std::vector<float> samples;
+  SrtSegment segment;
+};
+
+// 100 ms of audio per event; the queue bounds how far the readers can run ahead.
+constexpr size_t kAudioBlockSamples = 1600;
+constexpr size_t kQueueCapacity = 64;
+
+std::string normalize_segment_text(std::string text) {
+  for (char& ch : text) {
+    if (ch == '\n') ch = ' ';
+  }
+  while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) text.erase(text.begin());
+  while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) text.pop_back();
+  return text;
+}
+
+void read_pcm(StreamInput& in, bool f32, BoundedQueue<StreamEvent>& events) {
+  const size_t sample_bytes = f32 ? 4 : 2;
+  std::vector<char> bytes(kAudioBlockSamples * sample_bytes);
+  size_t carry = 0;  // bytes of an incomplete trailing sample
+  for (;;) {
+    const size_t read = in.read(bytes.data() + carry, bytes.size() - carry);
+    if (read == 0) break;
+    const size_t got = carry + read;
+    const size_t n = got / sample_bytes;
+    if (n > 0) {
+      StreamEvent ev;
+      ev.kind = StreamEvent::Kind::Audio;
+      ev.samples.resize(n);
+      for (size_t i = 0; i < n; ++i) {
+        if (f32) {
+          std::memcpy(&ev.samples[i], bytes.data() + i * 4, 4);
+        } else {
+          int16_t v;
+          std::memcpy(&v, bytes.data() + i * 2, 2);
+          ev.samples[i] = float(v) / 32768.0f;
+        }
+      }
+      if (!events.push(std::move(ev))) return;
+    }
+    carry = got - n * sample_bytes;
+    if (carry) std::memmove(bytes.data(), bytes.data() + n * sample_bytes, carry);
+  }
+}
+
+void read_text_lines(StreamInput& in, BoundedQueue<StreamEvent>& events) {
+  int index = 1;
+  auto push_line = [&](std::string line) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.find_first_not_of(" \t") == std::string::npos) return true;
+    StreamEvent ev;
+    ev.kind = StreamEvent::Kind::Text;
+    ev.segment = parse_json_segment_line(line, index++);
+    return events.push(std::move(ev));
+  };
+  std::string pending;
+  char buf[4096];
+  for (size_t n; (n = in.read(buf, sizeof(buf))) > 0;) {
+    pending.append(buf, n);
+    size_t start = 0;
+    for (size_t nl; (nl = pending.find('\n', start)) != std::string::npos; start = nl + 1) {
+      if (!push_line(pending.substr(start, nl - start))) return;
+    }
+    pending.erase(0, start);
+  }
+  push_line(std::move(pending));
+}
+
+}  // namespace
+
+int run_stream_alignment(
+    const CliArgs& args,
+    Ort::Session& session,
+    const Vocab& vocab,
+    const PreprocessConfig& prep_config,
+    Logger& log) {
+  StreamInput audio_in(args.audio, "audio stream");
+  StreamInput text_in(args.json_input, "transcript stream");
+
+  std::ofstream out_file;
+  const bool out_stdout = args.json_output.empty() || args.json_output.string() == "-";
+  if (!out_stdout) {
+    out_file.open(args.json_output, std::ios::binary);
+    if (!out_file) throw std::runtime_error("Failed to open for writing: " + args.json_output.string());
+  }
+  std::ostream& out = out_stdout ? static_cast<std::ostream&>(std::cout) : out_file;
+
+  // Batch mode scores <star> at 0 and relies on the path having to reach the end of the
+  // transcript. Here the end is unknown, so a free <star> would absorb every frame; score it
+  // like a uniform guess over the vocab instead, so it only wins where no token fits.
+  const float log_vocab = std::log(static_cast<float>(vocab.vocab_size()));
+  StreamingEmissions emissions(session, args.stream_window, /*context_seconds=*/1, /*star_logp=*/-log_vocab);
+  const int stride_ms = emissions.stride_ms();
+  PreprocessConfig id_config = prep_config;
+  id_config.token_strings = false;
+  const int64_t classes = vocab.star_id + 1;
+  const int64_t max_latency_frames = int64_t(std::lround(args.max_latency * 1000.0 / stride_ms));
+
+  // Segments appended but not yet reported; reported in order, then dropped.
+  std::deque<SrtSegment> waiting;
+  size_t waiting_base = 0;
+  size_t emitted = 0;
+  OnlineAligner aligner(
+      classes, vocab.blank_id, vocab.star_id, log_vocab,
+      max_latency_frames, [&](const OnlineSegmentResult& r) {
+        SrtSegment& seg = waiting[r.segment - waiting_base];
+        if (r.aligned) {
+          seg.start_sec = double(r.start_frame) * stride_ms / 1000.0;
+          seg.end_sec = double(r.end_frame) * stride_ms / 1000.0;
+          seg.score = r.score;
+        } else {
+          seg.score = 0.0f;
+        }
+        out << format_json_segment_line(seg) << "\n";
+        out.flush();
+        waiting.pop_front();
+        ++waiting_base;
+        ++emitted;
+      });
+
+  std::vector<float> rows;
+  auto push_rows = [&] {
+    if (rows.empty()) return;
+    if (emissions.classes() != classes) {
+      throw std::runtime_error(
+          "vocab size mismatch: emissions classes=" + std::to_string(emissions.classes()) + ", vocab+star=" +
+          std::to_string(classes) + " (check matching model + vocab file)");
+    }
+    for (size_t off = 0; off < rows.size(); off += size_t(classes)) aligner.push_frame(rows.data() + off);
+    rows.clear();
+  };
+
+  BoundedQueue<StreamEvent> events(kQueueCapacity);
+  std::exception_ptr audio_error;
+  std::exception_ptr text_error;
+  std::atomic<int> readers_running{2};
+  std::thread audio_thread([&] {
+    try {
+      read_pcm(audio_in, args.pcm_format == "f32le", events);
+    } catch (...) {
+      audio_error = std::current_exception();
+    }
+    StreamEvent ev;
+    ev.kind = StreamEvent::Kind::AudioEnd;
+    events.push(std::move(ev));
+    --readers_running;
+  });
+  std::thread text_thread([&] {
+    try {
+      read_text_lines(text_in, events);
+    } catch (...) {
+      text_error = std::current_exception();
+    }
+    StreamEvent ev;
+    ev.kind = StreamEvent::Kind::TextEnd;
+    events.push(std::move(ev));
+    --readers_running;
+  });
+  // Stops the readers early: they may be blocked reading a live pipe or pushing to a full queue.
+  auto stop_readers = [&] {
+    events.close();
+    while (readers_running > 0) {
+      audio_in.cancel();
+      text_in.cancel();
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    audio_thread.join();
+    text_thread.join();
+  };
+
+  bool audio_done = false;
+  bool text_done = false;
+  try {
+    while (!(audio_done && text_done)) {
+      auto ev = events.pop();
+      if (!ev) break;
+      switch (ev->kind) {
+        case StreamEvent::Kind::Audio:
+          emissions.push(ev->samples.data(), ev->samples.size(), rows);
+          push_rows();
+          break;
+        case StreamEvent::Kind::AudioEnd:
+          audio_done = true;
+          emissions.finish(rows);
+          push_rows();
+          break;
+        case StreamEvent::Kind::Text: {
+          const std::string text = normalize_segment_text(ev->segment.text);
+          const auto prep = preprocess_text(text, vocab, id_config);
+          waiting.push_back(std::move(ev->segment));
+          aligner.append_segment(prep.targets);
+          break;
+        }
+        case StreamEvent::Kind::TextEnd:
+          text_done = true;
+          aligner.close_text();
+          break;
+      }
+    }
+    aligner.finish();
+  } catch (...) {
+    stop_readers();
+    throw;
+  }
+  events.close();
+  audio_thread.join();
+  text_thread.join();
+  if (audio_error) std::rethrow_exception(audio_error);
+  if (text_error) std::rethrow_exception(text_error);
+
+  {
+    std::ostringstream ss;
+    ss << "[stream] " << aligner.frames() << " frames (" << (double(aligner.frames()) * stride_ms / 1000.0)
+       << " s), " << emitted << " segments";
+    log.info(ss.str());
+  }
+  return 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+
+#include "cli_args.h"
+#include "logger.h"
+#include "text_preprocess.h"
+#include "vocab.h"
+
+// Live alignment (--stream).
+// Reads 16 kHz mono PCM from args.audio and JSON-lines transcript pieces from args.json_input
+// (either may be '-' for stdin, not both), computes emissions on a rolling window and runs an
+// online Viterbi. Each segment is written as one JSON line to args.json_output (stdout by
+// default) as soon as its timing is committed: at most --max-latency + --stream-window + 1 s (the
+// right context each window waits for) after its audio arrived, plus inference time.
+int run_stream_alignment(
+    const CliArgs& args,
+    Ort::Session& session,
+    const Vocab& vocab,
+    const PreprocessConfig& prep_config,
+    Logger& log);
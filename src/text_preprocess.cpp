@@ -2,9 +2,13 @@
 #include "kana_romaji.h"
 #include "utf8_utils.h"
 
+#include <atomic>
 #include <cctype>
-#include <regex>
+#include <functional>
+#include <list>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -55,6 +59,24 @@ static std::string strip_pinyin_tones(const std::string& s) {
   return result;
 }
 
+// Same bytes as std::regex_replace(s, std::regex(R"(\s+)"), " ") in the classic locale:
+// every run of ASCII whitespace becomes one space.
+static std::string collapse_whitespace(const std::string& s) {
+  std::string out;
+  out.reserve(s.size());
+  bool in_space = false;
+  for (char c : s) {
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      if (!in_space) out.push_back(' ');
+      in_space = true;
+    } else {
+      out.push_back(c);
+      in_space = false;
+    }
+  }
+  return out;
+}
+
 static std::string normalize_uroman_cpp(std::string s) {
   // First strip pinyin tone marks
   s = strip_pinyin_tones(s);
@@ -84,34 +106,41 @@ static std::string normalize_uroman_cpp(std::string s) {
 }
 
 
-static std::vector<std::string> split_text_word_or_char(const std::string& text, bool force_char) {
-  if (force_char) return utf8::split_chars(text);
-  std::vector<std::string> out;
-  std::string cur;
-  for (size_t i = 0; i < text.size();) {
-    unsigned char c = static_cast<unsigned char>(text[i]);
-    if (c < 0x80 && std::isspace(c)) {
-      if (!cur.empty()) out.push_back(cur);
-      cur.clear();
-      ++i;
+// Calls fn(chunk) for every chunk of `text` (views into it): its characters, or its words
+// split on ASCII whitespace.
+template <typename Fn>
+static void for_each_chunk(std::string_view text, bool force_char, Fn&& fn) {
+  if (force_char) {
+    for (std::string_view ch : utf8::chars(text)) fn(ch);
+    return;
+  }
+  size_t word_begin = 0;
+  size_t word_end = 0;
+  for (auto it = utf8::chars(text).begin(), end = utf8::chars(text).end(); it != end; ++it) {
+    const std::string_view ch = *it;
+    if (ch.size() == 1 && static_cast<unsigned char>(ch[0]) < 0x80 && std::isspace(static_cast<unsigned char>(ch[0]))) {
+      if (word_end > word_begin) fn(text.substr(word_begin, word_end - word_begin));
+      word_begin = word_end = it.offset() + 1;
       continue;
     }
-    // utf8 char
-    size_t n = 1;
-    if (c < 0x80)
-      n = 1;
-    else if ((c >> 5) == 0x6)
-      n = 2;
-    else if ((c >> 4) == 0xE)
-      n = 3;
-    else if ((c >> 3) == 0x1E)
-      n = 4;
-    if (i + n > text.size()) n = 1;
-    cur.append(text.substr(i, n));
-    i += n;
+    word_end = it.offset() + ch.size();
+  }
+  if (word_end > word_begin) fn(text.substr(word_begin, word_end - word_begin));
+}
+
+// `s` with runs of ASCII whitespace collapsed to one space and the ends trimmed, into `out`.
+static void collapse_trim(std::string_view s, std::string& out) {
+  out.clear();
+  bool pending_space = false;
+  for (char c : s) {
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      pending_space = !out.empty();
+    } else {
+      if (pending_space) out.push_back(' ');
+      out.push_back(c);
+      pending_space = false;
+    }
   }
-  if (!cur.empty()) out.push_back(cur);
-  return out;
 }
 
 // Pure C++ romanization using kana_romaji module
@@ -126,14 +155,14 @@ static std::string romanize_text(const std::string& norm_text) {
 
   // 3. Join characters with spaces (like Python's " ".join(text.strip()))
   std::string joined;
-  const auto chars = utf8::split_chars(stripped);
-  for (size_t k = 0; k < chars.size(); ++k) {
-    if (k) joined.push_back(' ');
-    joined += chars[k];
+  joined.reserve(stripped.size() * 2);
+  for (std::string_view ch : utf8::chars(stripped)) {
+    if (!joined.empty()) joined.push_back(' ');
+    joined += ch;
   }
 
   // 4. Collapse whitespace to single spaces
-  joined = std::regex_replace(joined, std::regex(R"(\s+)"), " ");
+  joined = collapse_whitespace(joined);
   while (!joined.empty() && joined.front() == ' ') joined.erase(joined.begin());
   while (!joined.empty() && joined.back() == ' ') joined.pop_back();
 
@@ -141,130 +170,220 @@ static std::string romanize_text(const std::string& norm_text) {
   return normalize_uroman_cpp(joined);
 }
 
-// Tokenize UTF-8 text for Omnilingual model (direct vocab lookup, no romanization)
-static std::vector<std::string> tokenize_utf8_for_omnilingual(
-    const std::string& text,
-    const Vocab& vocab) {
-  std::vector<std::string> tokens;
-  const auto chars = utf8::split_chars(text);
+// Bounded LRU memo for romanize_text(), keyed by the whitespace-normalized chunk.
+// Subtitles repeat a lot (names, catchphrases, lyrics), and in character mode every chunk
+// is a single character, so most lookups hit. One instance serves every preprocess_text
+// call in the process (all sub-batches and jobs); it is split into independently locked
+// shards so concurrent callers rarely contend. Entries depend on the loaded pinyin table.
+class RomanizeCache {
+ public:
+  // Romanization of `text` into `out` (assigned, so a reused `out` does not reallocate).
+  void romanize(std::string_view text, std::string& out) {
+    if (text.size() > kMaxKeyBytes) {
+      misses_.fetch_add(1, std::memory_order_relaxed);
+      out = romanize_text(std::string(text));
+      return;
+    }
+    Shard& shard = shards_[std::hash<std::string_view>{}(text) % kShards];
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      const auto it = shard.index.find(text);
+      if (it != shard.index.end()) {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        out = it->second->second;
+        return;
+      }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    out = romanize_text(std::string(text));
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.index.find(text) == shard.index.end()) {
+      shard.lru.emplace_front(std::string(text), out);
+      shard.index.emplace(shard.lru.front().first, shard.lru.begin());
+      if (shard.lru.size() > kEntriesPerShard) {
+        shard.index.erase(shard.lru.back().first);
+        shard.lru.pop_back();
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
 
-  for (const auto& ch : chars) {
+  RomanizeCacheStats stats() {
+    RomanizeCacheStats st;
+    st.hits = hits_.load(std::memory_order_relaxed);
+    st.misses = misses_.load(std::memory_order_relaxed);
+    st.evictions = evictions_.load(std::memory_order_relaxed);
+    for (Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      st.entries += shard.lru.size();
+    }
+    return st;
+  }
+
+ private:
+  static constexpr size_t kShards = 16;
+  static constexpr size_t kEntriesPerShard = 2048;
+  static constexpr size_t kMaxKeyBytes = 256;  // longer chunks are romanized uncached
+
+  struct Shard {
+    std::mutex mutex;
+    // Most recently used first; index keys view the strings stored in the list nodes.
+    std::list<std::pair<std::string, std::string>> lru;
+    std::unordered_map<std::string_view, std::list<std::pair<std::string, std::string>>::iterator> index;
+  };
+
+  Shard shards_[kShards];
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  std::atomic<uint64_t> evictions_{0};
+};
+
+RomanizeCache& romanize_cache() {
+  static RomanizeCache cache;
+  return cache;
+}
+
+constexpr std::string_view kStar = "<star>";
+
+// Tokenize UTF-8 text for Omnilingual model (direct vocab lookup, no romanization)
+// Appends the vocab id of every token to `ids`, and the tokens joined by spaces to `joined`
+// if given.
+static void tokenize_utf8_for_omnilingual(
+    std::string_view text,
+    const Vocab& vocab,
+    std::vector<int64_t>& ids,
+    std::string* joined) {
+  for (std::string_view ch : utf8::chars(text)) {
     // Skip whitespace - CJK languages don't use space as word separator
     // and including space as token causes issues with space-separated token joining
     if (ch.size() == 1 && std::isspace(static_cast<unsigned char>(ch[0]))) {
       continue;
     }
 
-    // Try direct lookup first
-    if (vocab.token_to_id.count(ch)) {
-      tokens.push_back(ch);
-      continue;
+    int64_t id = vocab.token_id(ch);
+    uint32_t lower_cp = 0;
+    if (id < 0) {
+      // Try lowercase: ASCII and common Unicode uppercase ranges
+      const uint32_t cp = utf8::to_codepoint(ch);
+      id = vocab.lower_char_id(cp);
+      lower_cp = utf8::simple_lower(cp);
     }
+    // Unknown character - silently skip (punctuation, etc.)
+    if (id < 0) continue;
 
-    // Try lowercase: ASCII and common Unicode uppercase ranges
-    uint32_t cp = utf8::to_codepoint(std::string_view(ch.data(), ch.size()));
-    uint32_t lower_cp = cp;
-    if (cp >= 'A' && cp <= 'Z') {
-      lower_cp = cp + 0x20;
-    } else if ((cp >= 0x00C0 && cp <= 0x00D6) || (cp >= 0x00D8 && cp <= 0x00DE)) {
-      lower_cp = cp + 0x20;  // Latin Extended uppercase (À-Ö, Ø-Þ)
-    } else if (cp >= 0x0410 && cp <= 0x042F) {
-      lower_cp = cp + 0x20;  // Cyrillic А-Я → а-я
-    } else if (cp >= 0x0400 && cp <= 0x040F) {
-      lower_cp = cp + 0x50;  // Cyrillic Ё etc. → ё etc.
-    } else if ((cp >= 0x0391 && cp <= 0x03A1) || (cp >= 0x03A3 && cp <= 0x03A9)) {
-      lower_cp = cp + 0x20;  // Greek Α-Ω → α-ω
-    }
-    if (lower_cp != cp) {
-      std::string lower_ch = utf8::from_codepoint(lower_cp);
-      if (vocab.token_to_id.count(lower_ch)) {
-        tokens.push_back(lower_ch);
-        continue;
-      }
+    ids.push_back(id);
+    if (!joined) continue;
+    if (!joined->empty()) joined->push_back(' ');
+    if (lower_cp) {
+      *joined += utf8::from_codepoint(lower_cp);
+    } else {
+      *joined += ch;
     }
-
-    // Unknown character - silently skip (punctuation, etc.)
   }
+}
 
-  return tokens;
+// Appends the vocab id of every space-separated piece of `token`; unknown pieces are dropped.
+static void append_piece_ids(std::string_view token, const Vocab& vocab, std::vector<int64_t>& ids) {
+  size_t pos = 0;
+  while (pos < token.size()) {
+    size_t next = token.find(' ', pos);
+    if (next == std::string_view::npos) next = token.size();
+    if (next > pos) {
+      const int64_t id = vocab.token_id(token.substr(pos, next - pos));
+      if (id >= 0) ids.push_back(id);
+    }
+    pos = next + 1;
+  }
 }
 
 }  // namespace
 
-PreprocessResult preprocess_text(
-    const std::string& full_text,
+void preprocess_text(
+    std::string_view text,
     const Vocab& vocab,
-    const PreprocessConfig& config) {
-  PreprocessResult r;
-  r.full_text = full_text;
-
+    const PreprocessConfig& config,
+    PreprocessResult& r) {
   const bool force_char = (config.language == "jpn" || config.language == "chi" ||
                            config.language == "cmn" || config.language == "kor" ||
                            config.language == "zho");
-  const auto text_split = split_text_word_or_char(full_text, force_char);
 
-  std::vector<std::string> tokens;
-  tokens.reserve(text_split.size());
+  // Per-thread scratch, reused across chunks and calls.
+  thread_local std::string key;
+  thread_local std::string token;
+
+  // Each chunk becomes "<star>" + its token; ids are emitted per chunk as we go.
+  if (!r.token_offsets.empty()) r.token_offsets.pop_back();
+  auto begin_chunk = [&](std::string_view chunk) {
+    r.token_offsets.push_back(r.targets.size());
+    r.targets.push_back(vocab.star_id);
+    r.token_offsets.push_back(r.targets.size());
+    r.text_starred.push_back(kStar);
+    r.text_starred.push_back(chunk);
+  };
+  auto end_chunk = [&](std::string_view chunk_token) {
+    if (!config.token_strings) return;
+    r.tokens_starred.emplace_back(kStar);
+    r.tokens_starred.emplace_back(chunk_token);
+  };
 
   if (config.romanize) {
     // MMS-style: romanize then normalize
-    for (const auto& chunk : text_split) {
-      std::string out = chunk;
-      out = std::regex_replace(out, std::regex(R"(\s+)"), " ");
-      while (!out.empty() && std::isspace(static_cast<unsigned char>(out.front()))) out.erase(out.begin());
-      while (!out.empty() && std::isspace(static_cast<unsigned char>(out.back()))) out.pop_back();
-      tokens.push_back(romanize_text(out));
-    }
+    for_each_chunk(text, force_char, [&](std::string_view chunk) {
+      collapse_trim(chunk, key);
+      begin_chunk(chunk);
+      romanize_cache().romanize(key, token);
+      append_piece_ids(token, vocab, r.targets);
+      end_chunk(token);
+    });
   } else if (vocab.format == VocabFormat::TXT) {
     // Omnilingual-style: UTF-8 character-level tokenization with direct vocab lookup
-    for (const auto& chunk : text_split) {
-      const auto chunk_tokens = tokenize_utf8_for_omnilingual(chunk, vocab);
-      // Join tokens with space separator
-      std::string joined;
-      for (size_t k = 0; k < chunk_tokens.size(); ++k) {
-        if (k > 0) joined.push_back(' ');
-        joined += chunk_tokens[k];
-      }
-      tokens.push_back(joined);
-    }
+    for_each_chunk(text, force_char, [&](std::string_view chunk) {
+      begin_chunk(chunk);
+      token.clear();
+      tokenize_utf8_for_omnilingual(chunk, vocab, r.targets, config.token_strings ? &token : nullptr);
+      end_chunk(token);
+    });
   } else {
-    // MMS non-romanized (English): normalize to a-z only
-    for (const auto& chunk : text_split) {
-      std::string out = chunk;
-      out = std::regex_replace(out, std::regex(R"(\s+)"), " ");
-      while (!out.empty() && std::isspace(static_cast<unsigned char>(out.front()))) out.erase(out.begin());
-      while (!out.empty() && std::isspace(static_cast<unsigned char>(out.back()))) out.pop_back();
-
-      const auto chars = utf8::split_chars(out);
-      std::string joined;
-      for (size_t k = 0; k < chars.size(); ++k) {
-        if (chars[k].size() == 1) {
-          char c = chars[k][0];
+    // MMS non-romanized (English): normalize to a-z only. Whitespace is dropped along with
+    // every other non-letter, so the chunk needs no collapsing first.
+    for_each_chunk(text, force_char, [&](std::string_view chunk) {
+      begin_chunk(chunk);
+      token.clear();
+      for (std::string_view ch : utf8::chars(chunk)) {
+        if (ch.size() == 1) {
+          char c = ch[0];
           if (c >= 'A' && c <= 'Z') {
             c = c - 'A' + 'a';
           }
           if ((c >= 'a' && c <= 'z') || c == '\'') {
-            if (!joined.empty()) joined.push_back(' ');
-            joined.push_back(c);
+            if (!token.empty()) token.push_back(' ');
+            token.push_back(c);
+            const int64_t id = vocab.char_id(static_cast<unsigned char>(c));
+            if (id >= 0) r.targets.push_back(id);
           }
         }
       }
-      tokens.push_back(joined);
-    }
+      end_chunk(token);
+    });
   }
+  r.token_offsets.push_back(r.targets.size());
+}
 
-  // star_frequency = "segment" as used by align.py
-  r.tokens_starred.reserve(tokens.size() * 2);
-  r.text_starred.reserve(text_split.size() * 2);
-  for (size_t i = 0; i < tokens.size(); ++i) {
-    r.tokens_starred.push_back("<star>");
-    r.tokens_starred.push_back(tokens[i]);
-    r.text_starred.push_back("<star>");
-    r.text_starred.push_back(text_split[i]);
-  }
+PreprocessResult preprocess_text(
+    std::string_view full_text,
+    const Vocab& vocab,
+    const PreprocessConfig& config) {
+  PreprocessResult r;
+  preprocess_text(full_text, vocab, config, r);
   return r;
 }
 
+RomanizeCacheStats romanize_cache_stats() {
+  return romanize_cache().stats();
+}
+
 // Legacy API for backward compatibility (MMS-style preprocessing)
 PreprocessResult preprocess_text_cpp(const std::string& full_text, const std::string& language, bool romanize) {
   // Create a dummy MMS-style vocab for legacy API
@@ -274,6 +393,7 @@ PreprocessResult preprocess_text_cpp(const std::string& full_text, const std::st
   PreprocessConfig config;
   config.romanize = romanize;
   config.language = language;
+  config.token_strings = true;  // the dummy vocab yields no ids; the token strings are the output
 
   return preprocess_text(full_text, dummy_vocab, config);
 }
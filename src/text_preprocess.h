@@ -1,15 +1,23 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 #include "vocab.h"
 
+// text_starred views the preprocessed text (chunks) and static storage ("<star>"), so the text
+// must outlive the result.
 struct PreprocessResult {
-  std::vector<std::string> tokens_starred;
-  std::vector<std::string> text_starred;
-  std::string full_text;
+  std::vector<std::string> tokens_starred;  // empty unless PreprocessConfig::token_strings
+  std::vector<std::string_view> text_starred;
+  // Target ids of tokens_starred, as CTC alignment consumes them ("<star>" -> vocab.star_id;
+  // space-separated pieces not in the vocab are dropped). Entry i of tokens_starred/text_starred
+  // owns targets[token_offsets[i], token_offsets[i + 1]); token_offsets has one extra entry.
+  std::vector<int64_t> targets;
+  std::vector<size_t> token_offsets;
 };
 
 struct PreprocessConfig {
@@ -17,18 +25,39 @@ struct PreprocessConfig {
   bool normalize_english = true;   // Convert uppercase to lowercase
   bool filter_punctuation = true;  // Filter out punctuation
   std::string language;            // ISO 639-3 code (e.g. "jpn", "eng")
+  bool token_strings = false;      // Also build tokens_starred (alignment only needs the ids)
 };
 
 // Preprocess text for CTC alignment with vocab lookup.
 // For Omnilingual models: UTF-8 character-level tokenization with direct vocab lookup.
 // For MMS models: romanization + character-level tokenization.
 PreprocessResult preprocess_text(
-    const std::string& full_text,
+    std::string_view full_text,
     const Vocab& vocab,
     const PreprocessConfig& config);
 
+// Same, appending the chunks of `text` to `out` (which may already hold other chunks); target
+// offsets continue from out.targets and token_offsets keeps its single trailing entry. Reusing
+// one result across many texts avoids per-text allocations.
+void preprocess_text(
+    std::string_view text,
+    const Vocab& vocab,
+    const PreprocessConfig& config,
+    PreprocessResult& out);
+
+// Counters of the process-wide romanization memo used by preprocess_text (romanize mode).
+struct RomanizeCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  size_t entries = 0;
+};
+
+RomanizeCacheStats romanize_cache_stats();
+
 // Legacy API for backward compatibility (MMS-style preprocessing)
 // - full_text: already concatenated with single spaces between SRT segments
 // - language: ISO 639-3 code (e.g. "jpn")
 // - romanize: if true, use C++ romanization for CJK languages
+// The result views full_text.
 PreprocessResult preprocess_text_cpp(const std::string& full_text, const std::string& language, bool romanize);
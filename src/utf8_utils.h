@@ -1,9 +1,18 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <string>
 #include <string_view>
-#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UTF8_UTILS_SSE2 1
+#else
+#define UTF8_UTILS_SSE2 0
+#endif
 
 namespace utf8 {
 
@@ -36,6 +45,17 @@ inline uint32_t to_codepoint(std::string_view s) {
   return 0;
 }
 
+// Lowercase of an uppercase Latin (ASCII, Latin-1), Greek or Cyrillic codepoint; any other
+// codepoint is returned unchanged.
+inline uint32_t simple_lower(uint32_t cp) {
+  if (cp >= 'A' && cp <= 'Z') return cp + 0x20;
+  if ((cp >= 0x00C0 && cp <= 0x00D6) || (cp >= 0x00D8 && cp <= 0x00DE)) return cp + 0x20;  // À-Ö, Ø-Þ
+  if (cp >= 0x0410 && cp <= 0x042F) return cp + 0x20;  // Cyrillic А-Я → а-я
+  if (cp >= 0x0400 && cp <= 0x040F) return cp + 0x50;  // Cyrillic Ё etc. → ё etc.
+  if ((cp >= 0x0391 && cp <= 0x03A1) || (cp >= 0x03A3 && cp <= 0x03A9)) return cp + 0x20;  // Greek Α-Ω → α-ω
+  return cp;
+}
+
 // Encode a Unicode codepoint to a UTF-8 string.
 inline std::string from_codepoint(uint32_t cp) {
   std::string s;
@@ -57,25 +77,95 @@ inline std::string from_codepoint(uint32_t cp) {
   return s;
 }
 
-// Split a UTF-8 string into individual characters.
-inline std::vector<std::string> split_chars(const std::string& s) {
-  std::vector<std::string> out;
-  for (size_t i = 0; i < s.size();) {
-    size_t n = char_len(static_cast<unsigned char>(s[i]));
-    if (i + n > s.size()) n = 1;
-    out.push_back(s.substr(i, n));
-    i += n;
+// Length of the leading all-ASCII run of s. Checks 16 bytes at a time with SSE2 where
+// available, then 8 at a time in a 64-bit word.
+inline size_t ascii_prefix(std::string_view s) {
+  const char* p = s.data();
+  const size_t n = s.size();
+  size_t i = 0;
+#if UTF8_UTILS_SSE2
+  for (; i + 16 <= n; i += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    if (_mm_movemask_epi8(v) != 0) break;
   }
-  return out;
+#endif
+  for (; i + 8 <= n; i += 8) {
+    uint64_t w;
+    std::memcpy(&w, p + i, sizeof(w));
+    if ((w & 0x8080808080808080ull) != 0) break;
+  }
+  while (i < n && static_cast<unsigned char>(p[i]) < 0x80) ++i;
+  return i;
 }
 
-// Count the number of Unicode codepoints in a UTF-8 string.
-inline size_t codepoint_count(const std::string& s) {
+inline bool is_ascii(std::string_view s) { return ascii_prefix(s) == s.size(); }
+
+// Byte length of the character at s[i]; a sequence cut off by the end of s counts as one byte.
+inline size_t char_len_at(std::string_view s, size_t i) {
+  const size_t n = char_len(static_cast<unsigned char>(s[i]));
+  return i + n > s.size() ? 1 : n;
+}
+
+// Forward iterator over the characters of a UTF-8 string, as views into it. Invalid lead
+// bytes and truncated sequences come out as single bytes.
+class CharIterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = std::string_view;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const std::string_view*;
+  using reference = std::string_view;
+
+  CharIterator() = default;
+  CharIterator(std::string_view s, size_t pos) : s_(s), pos_(pos), len_(pos < s.size() ? char_len_at(s, pos) : 0) {}
+
+  std::string_view operator*() const { return std::string_view(s_.data() + pos_, len_); }
+  size_t offset() const { return pos_; }  // byte offset of the current character
+
+  CharIterator& operator++() {
+    pos_ += len_;
+    len_ = pos_ < s_.size() ? char_len_at(s_, pos_) : 0;
+    return *this;
+  }
+  CharIterator operator++(int) {
+    CharIterator prev = *this;
+    ++*this;
+    return prev;
+  }
+
+  bool operator==(const CharIterator& other) const { return pos_ == other.pos_; }
+  bool operator!=(const CharIterator& other) const { return pos_ != other.pos_; }
+
+ private:
+  std::string_view s_;
+  size_t pos_ = 0;
+  size_t len_ = 0;
+};
+
+// Range over the characters of s: for (std::string_view ch : utf8::chars(text)) ...
+// The views point into s, which must outlive the loop.
+class Chars {
+ public:
+  explicit Chars(std::string_view s) : s_(s) {}
+  CharIterator begin() const { return CharIterator(s_, 0); }
+  CharIterator end() const { return CharIterator(s_, s_.size()); }
+
+ private:
+  std::string_view s_;
+};
+
+inline Chars chars(std::string_view s) { return Chars(s); }
+
+// Count the number of Unicode codepoints in a UTF-8 string (as chars() splits it).
+inline size_t codepoint_count(std::string_view s) {
   size_t count = 0;
-  for (size_t i = 0; i < s.size();) {
-    size_t n = char_len(static_cast<unsigned char>(s[i]));
-    if (i + n > s.size()) n = 1;
-    i += n;
+  size_t i = 0;
+  while (i < s.size()) {
+    const size_t ascii = ascii_prefix(s.substr(i));
+    count += ascii;
+    i += ascii;
+    if (i >= s.size()) break;
+    i += char_len_at(s, i);
     ++count;
   }
   return count;
@@ -1,9 +1,166 @@
 #include "vocab.h"
+#include "utf8_utils.h"
 
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+constexpr uint32_t kMaxCodepoint = 0x10FFFF;
+constexpr uint32_t kPageBits = 8;
+constexpr uint32_t kPageSize = 1u << kPageBits;
+// Ids index a dense array; anything past this is a broken vocab file.
+constexpr int64_t kMaxId = (int64_t(1) << 24) - 1;
+
+// True if `s` is exactly one well-formed UTF-8 codepoint (stored in `cp`). Such tokens go to
+// the direct-index table; everything else goes to the multi-char hash.
+bool single_codepoint(std::string_view s, uint32_t& cp) {
+  if (s.empty()) return false;
+  const auto c0 = static_cast<unsigned char>(s[0]);
+  const size_t n = utf8::char_len(c0);
+  if (n != s.size()) return false;
+  if (n == 1) {
+    cp = c0;
+    return c0 < 0x80;
+  }
+  for (size_t i = 1; i < n; ++i) {
+    if ((static_cast<unsigned char>(s[i]) & 0xC0) != 0x80) return false;
+  }
+  cp = utf8::to_codepoint(s);
+  const uint32_t min_cp = n == 2 ? 0x80 : n == 3 ? 0x800 : 0x10000;
+  return cp >= min_cp && cp <= kMaxCodepoint;
+}
+
+// FNV-1a with a seeded offset basis and a final avalanche.
+uint64_t hash_token(std::string_view s, uint64_t seed) {
+  uint64_t h = 1469598103934665603ull ^ (seed * 0x9E3779B97F4A7C15ull);
+  for (char c : s) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 1099511628211ull;
+  }
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDull;
+  h ^= h >> 33;
+  return h;
+}
+
+}  // namespace
+
+Vocab::CharEntry* Vocab::char_entry(uint32_t cp) {
+  if (cp > kMaxCodepoint) return nullptr;
+  if (page_of_.empty()) page_of_.assign((kMaxCodepoint >> kPageBits) + 1, -1);
+  int32_t& page = page_of_[cp >> kPageBits];
+  if (page < 0) {
+    page = int32_t(pages_.size() / kPageSize);
+    pages_.resize(pages_.size() + kPageSize);
+  }
+  return &pages_[size_t(page) * kPageSize + (cp & (kPageSize - 1))];
+}
+
+const Vocab::CharEntry* Vocab::char_entry(uint32_t cp) const {
+  if (cp > kMaxCodepoint || page_of_.empty()) return nullptr;
+  const int32_t page = page_of_[cp >> kPageBits];
+  if (page < 0) return nullptr;
+  return &pages_[size_t(page) * kPageSize + (cp & (kPageSize - 1))];
+}
+
+void Vocab::assign(const std::vector<std::pair<std::string, int64_t>>& entries) {
+  std::unordered_map<std::string, int64_t> token_to_id;
+  int64_t max_id = -1;
+  for (const auto& [token, id] : entries) {
+    if (id < 0 || id > kMaxId) throw std::runtime_error("Vocab id out of range for token '" + token + "': " + std::to_string(id));
+    token_to_id[token] = id;
+    if (id > max_id) max_id = id;
+  }
+
+  num_tokens_ = token_to_id.size();
+  id_to_token_.assign(size_t(max_id + 1), std::string());
+  for (const auto& [token, id] : entries) id_to_token_[size_t(id)] = token;
+
+  page_of_.clear();
+  pages_.clear();
+  multi_tokens_.clear();
+  for (const auto& [token, id] : token_to_id) {
+    uint32_t cp = 0;
+    if (single_codepoint(token, cp)) {
+      char_entry(cp)->id = int32_t(id);
+    } else {
+      multi_tokens_.emplace_back(token, id);
+    }
+  }
+
+  // Cache the lowercase fallback of every uppercase codepoint whose lowercase form is a token.
+  for (uint32_t cp = 0; cp < 0x0430; ++cp) {
+    const uint32_t lower = utf8::simple_lower(cp);
+    if (lower == cp) continue;
+    const int64_t lower_id = char_id(lower);
+    if (lower_id >= 0) char_entry(cp)->lower_id = int32_t(lower_id);
+  }
+
+  // Two-level perfect hash: first-level buckets, each resolved with its own seed into b^2 slots.
+  buckets_.assign(std::max<size_t>(1, multi_tokens_.size()), Bucket{});
+  slots_.clear();
+  std::vector<std::vector<int32_t>> members(buckets_.size());
+  for (size_t i = 0; i < multi_tokens_.size(); ++i) {
+    members[hash_token(multi_tokens_[i].first, 0) % buckets_.size()].push_back(int32_t(i));
+  }
+  for (size_t b = 0; b < buckets_.size(); ++b) {
+    const auto& keys = members[b];
+    if (keys.empty()) continue;
+    Bucket& bucket = buckets_[b];
+    bucket.offset = uint32_t(slots_.size());
+    bucket.size = uint32_t(keys.size() * keys.size());
+    std::vector<int32_t> slots;
+    for (uint64_t seed = 1;; ++seed) {
+      slots.assign(bucket.size, -1);
+      bool ok = true;
+      for (int32_t k : keys) {
+        int32_t& slot = slots[hash_token(multi_tokens_[size_t(k)].first, seed) % bucket.size];
+        if (slot >= 0) {
+          ok = false;
+          break;
+        }
+        slot = k;
+      }
+      if (ok) {
+        bucket.seed = seed;
+        break;
+      }
+    }
+    slots_.insert(slots_.end(), slots.begin(), slots.end());
+  }
+}
+
+int64_t Vocab::char_id(uint32_t cp) const {
+  const CharEntry* e = char_entry(cp);
+  return e ? e->id : -1;
+}
+
+int64_t Vocab::lower_char_id(uint32_t cp) const {
+  const CharEntry* e = char_entry(cp);
+  return e ? e->lower_id : -1;
+}
+
+int64_t Vocab::token_id(std::string_view token) const {
+  uint32_t cp = 0;
+  if (single_codepoint(token, cp)) return char_id(cp);
+  if (multi_tokens_.empty()) return -1;
+  const Bucket& bucket = buckets_[hash_token(token, 0) % buckets_.size()];
+  if (bucket.size == 0) return -1;
+  const int32_t k = slots_[bucket.offset + hash_token(token, bucket.seed) % bucket.size];
+  if (k < 0 || multi_tokens_[size_t(k)].first != token) return -1;
+  return multi_tokens_[size_t(k)].second;
+}
+
+const std::string& Vocab::token(int64_t id) const {
+  static const std::string empty;
+  if (id < 0 || size_t(id) >= id_to_token_.size()) return empty;
+  return id_to_token_[size_t(id)];
+}
 
 Vocab load_vocab_json(const std::filesystem::path& vocab_json_path) {
   std::ifstream f(vocab_json_path, std::ios::binary);
@@ -14,20 +171,20 @@ Vocab load_vocab_json(const std::filesystem::path& vocab_json_path) {
 
   Vocab v;
   v.format = VocabFormat::JSON;
+  std::vector<std::pair<std::string, int64_t>> entries;
   int64_t max_id = -1;
 
   for (const auto& [key, val] : j.items()) {
     const int64_t id = val.get<int64_t>();
-    v.token_to_id[key] = id;
-    v.id_to_token[id] = key;
+    entries.emplace_back(key, id);
     if (id > max_id) max_id = id;
   }
 
   // Append <star> as an extra label (torchaudio style)
   v.star_id = max_id + 1;
-  v.token_to_id["<star>"] = v.star_id;
-  v.id_to_token[v.star_id] = "<star>";
+  entries.emplace_back("<star>", v.star_id);
   v.blank_id = 0;  // MMS uses ID 0 for <blank>
+  v.assign(entries);
 
   return v;
 }
@@ -40,6 +197,7 @@ Vocab load_vocab_txt(const std::filesystem::path& tokens_txt_path) {
   if (!f) throw std::runtime_error("Failed to open tokens.txt: " + tokens_txt_path.string());
 
   std::string line;
+  std::vector<std::pair<std::string, int64_t>> entries;
   int64_t max_id = -1;
 
   while (std::getline(f, line)) {
@@ -60,18 +218,17 @@ Vocab load_vocab_txt(const std::filesystem::path& tokens_txt_path) {
     std::string token = line.substr(0, last_space);
     int64_t id = std::stoll(line.substr(last_space + 1));
 
-    v.token_to_id[token] = id;
-    v.id_to_token[id] = token;
+    entries.emplace_back(std::move(token), id);
     if (id > max_id) max_id = id;
   }
 
   // Append <star> token (torchaudio style)
   v.star_id = max_id + 1;
-  v.token_to_id["<star>"] = v.star_id;
-  v.id_to_token[v.star_id] = "<star>";
+  entries.emplace_back("<star>", v.star_id);
 
   // blank is typically ID 0 (<s> token in Omnilingual, which serves as blank)
   v.blank_id = 0;
+  v.assign(entries);
 
   return v;
 }
@@ -3,18 +3,61 @@
 #include <cstdint>
 #include <filesystem>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 enum class VocabFormat { JSON, TXT };
 
+// Token <-> id tables of a CTC vocabulary.
+//
+// Nearly every token is a single codepoint; those live in a direct-index table of 256-codepoint
+// pages (allocated only where the vocab has tokens), next to the id of the codepoint's lowercase
+// form. The few multi-char tokens (<blank>, <s>, <star>, ...) sit in a two-level perfect hash,
+// and id -> token is a dense array. Lookups never allocate.
 struct Vocab {
-  std::unordered_map<std::string, int64_t> token_to_id;
-  std::unordered_map<int64_t, std::string> id_to_token;
   int64_t blank_id = 0;
   int64_t star_id = -1;  // Dynamically appended <star> token (torchaudio style)
   VocabFormat format = VocabFormat::JSON;
 
-  size_t vocab_size() const { return token_to_id.size(); }
+  // Build the tables from (token, id) pairs, replacing any previous contents. A repeated token
+  // or id keeps its last pair.
+  void assign(const std::vector<std::pair<std::string, int64_t>>& entries);
+
+  // Id of `token`, or -1 if it is not in the vocab.
+  int64_t token_id(std::string_view token) const;
+  // Id of the single-codepoint token `cp`, or -1.
+  int64_t char_id(uint32_t cp) const;
+  // Id of the lowercase form of `cp` (utf8::simple_lower), or -1 if `cp` has none or it is not
+  // in the vocab.
+  int64_t lower_char_id(uint32_t cp) const;
+  // Token with id `id`, or an empty string.
+  const std::string& token(int64_t id) const;
+
+  size_t vocab_size() const { return num_tokens_; }
+
+ private:
+  struct CharEntry {
+    int32_t id = -1;
+    int32_t lower_id = -1;
+  };
+  // Multi-char token bucket: its tokens sit at slots[offset + hash(token, seed) % size].
+  struct Bucket {
+    uint64_t seed = 0;
+    uint32_t offset = 0;
+    uint32_t size = 0;
+  };
+
+  CharEntry* char_entry(uint32_t cp);
+  const CharEntry* char_entry(uint32_t cp) const;
+
+  size_t num_tokens_ = 0;
+  std::vector<int32_t> page_of_;  // per 256-codepoint block: page index, or -1
+  std::vector<CharEntry> pages_;  // 256 entries per page
+  std::vector<Bucket> buckets_;
+  std::vector<int32_t> slots_;    // index into multi_tokens_, or -1
+  std::vector<std::pair<std::string, int64_t>> multi_tokens_;
+  std::vector<std::string> id_to_token_;
 };
 
 // Auto-detect format and load vocab from model directory.